@@ -0,0 +1,321 @@
+/*
+ * Heap aging benchmark.
+ *
+ * Replays N alloc/free cycles across several page families, the way a
+ * long running server churns its heap. Every cycle allocates one object
+ * from a family picked by weight, of 1 to 4 units for the families of
+ * variable length records, and with a lifetime in cycles drawn from an
+ * exponential distribution of one of three means :
+ *
+ *   90%  short lived    mean 1000 cycles
+ *    9%  session        mean 50000 cycles
+ *    1%  long lived     mean 2000000 cycles
+ *
+ * Objects whose lifetime ran out are freed before the next cycle. Every
+ * N/SAMPLES cycles the heap is sampled with mm_get_block_usage(), the
+ * walk mm_print_block_usage() does, and a CSV line is printed :
+ *
+ *   cycle       cycles replayed so far
+ *   live_kb     bytes the application asked for and holds
+ *   heap_kb     system pages in use by the page families
+ *   utilization live_kb / heap_kb
+ *   free_blocks free blocks, and free slab slots, over all families
+ *   free_kb     bytes in them
+ *   largest     largest free block of any family
+ *   avg_free    free_kb / free_blocks in bytes, free blocks never span
+ *               pages so it is their size rather than the largest one
+ *               which shows the heap splintering
+ *   rss_kb      resident set size
+ *   p50_ns, p99_ns, p999_ns
+ *               allocation latency over the cycles since the last sample
+ *
+ * Feed it to a plotting tool to chart fragmentation, RSS growth and
+ * latency over time, e.g. with gnuplot :
+ *
+ *   ./bench_aging 10000000 > aging.csv
+ *   set datafile separator ','
+ *   plot 'aging.csv' using 1:4 with lines, '' using 1:9 axes x1y2 with lines
+ *
+ * An optional second argument registers the families with a placement
+ * policy, worst (the default), best, first or densest, to compare them
+ * on the same replay :
+ *
+ *   ./bench_aging 10000000 densest > aging_densest.csv
+ *
+ * Build : gcc -O2 -I. -Iglthread bench/bench_aging.c mm.c \
+ *             glthread/glthread.c -lm -o bench_aging
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "uapi_mm.h"
+
+#define SAMPLES		100
+#define FAMILIES	5
+
+typedef struct family_ {
+
+	const char *name;
+	uint32_t size;
+	uint32_t max_units;
+	uint32_t weight;
+	mm_family_t handle;
+} family_t;
+
+static family_t families[FAMILIES] = {
+	{"aging_node",    24,   1, 40},
+	{"aging_session", 96,   1, 20},
+	{"aging_request", 200,  4, 20},
+	{"aging_record",  640,  4, 15},
+	{"aging_buffer",  2000, 2, 5},
+};
+
+typedef struct object_ {
+
+	uint64_t expiry;
+	void *ptr;
+	uint32_t bytes;
+} object_t;
+
+/*Min heap of the live objects on their expiry cycle*/
+static object_t *live;
+static uint32_t n_live, max_live;
+
+static void
+live_push(object_t object){
+
+	uint32_t i = n_live++, parent;
+
+	if(n_live > max_live){
+		max_live = max_live ? 2 * max_live : 65536;
+		live = realloc(live, max_live * sizeof(object_t));
+	}
+
+	while(i && live[parent = (i - 1) / 2].expiry > object.expiry){
+		live[i] = live[parent];
+		i = parent;
+	}
+	live[i] = object;
+}
+
+static object_t
+live_pop(){
+
+	object_t top = live[0], last = live[--n_live];
+	uint32_t i = 0, child;
+
+	while((child = 2 * i + 1) < n_live){
+		if(child + 1 < n_live && live[child + 1].expiry < live[child].expiry)
+			child++;
+		if(last.expiry <= live[child].expiry)
+			break;
+		live[i] = live[child];
+		i = child;
+	}
+	live[i] = last;
+	return top;
+}
+
+static inline uint64_t
+ticks(){
+
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static double
+now_ns(){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double
+ns_per_tick(){
+
+	double start_ns = now_ns(), end_ns;
+	uint64_t start = ticks();
+
+	do{
+		end_ns = now_ns();
+	} while(end_ns - start_ns < 50e6);
+	return (end_ns - start_ns) / (double)(ticks() - start);
+}
+
+static double
+uniform(){
+
+	return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+static uint64_t
+lifetime(){
+
+	double r = uniform(), mean;
+
+	if(r < 0.90)
+		mean = 1000;
+	else if(r < 0.99)
+		mean = 50000;
+	else
+		mean = 2000000;
+	return (uint64_t)(-mean * log(uniform())) + 1;
+}
+
+static const struct{
+
+	const char *name;
+	uint32_t flags;
+} policies[] = {
+	{"worst",   MM_FAMILY_WORST_FIT},
+	{"best",    MM_FAMILY_BEST_FIT},
+	{"first",   MM_FAMILY_FIRST_FIT},
+	{"densest", MM_FAMILY_DENSEST_PAGE},
+};
+
+static family_t *
+pick_family(){
+
+	uint32_t total = 0, i, r;
+
+	for(i = 0; i < FAMILIES; i++)
+		total += families[i].weight;
+	r = rand() % total;
+	for(i = 0; r >= families[i].weight; i++)
+		r -= families[i].weight;
+	return &families[i];
+}
+
+static unsigned long
+rss_kb(){
+
+	FILE *statm = fopen("/proc/self/statm", "r");
+	unsigned long size, resident = 0;
+
+	if(!statm)
+		return 0;
+	if(fscanf(statm, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(statm);
+	return resident * (getpagesize() / 1024);
+}
+
+static int
+compare_latency(const void *a, const void *b){
+
+	uint32_t first = *(const uint32_t *)a, second = *(const uint32_t *)b;
+
+	return first < second ? -1 : first > second;
+}
+
+static void
+sample(uint64_t cycle, uint64_t live_bytes, uint32_t *latency,
+	   uint32_t n_latency, double tick_ns){
+
+	mm_block_usage_t usage;
+	uint64_t heap_pages = 0, free_bytes = 0;
+	uint32_t free_blocks = 0, largest = 0, i;
+
+	for(i = 0; i < FAMILIES; i++){
+		mm_get_block_usage(families[i].handle, &usage);
+		heap_pages += usage.vm_pages;
+		free_blocks += usage.free_block_count;
+		free_bytes += usage.free_memory;
+		if(usage.largest_free_block > largest)
+			largest = usage.largest_free_block;
+	}
+
+	qsort(latency, n_latency, sizeof(uint32_t), compare_latency);
+
+	printf("%llu,%llu,%llu,%.3f,%u,%llu,%u,%.0f,%lu,%.1f,%.1f,%.1f\n",
+		   (unsigned long long)cycle,
+		   (unsigned long long)(live_bytes / 1024),
+		   (unsigned long long)(heap_pages * getpagesize() / 1024),
+		   heap_pages ? (double)live_bytes / (heap_pages * getpagesize()) : 0,
+		   free_blocks, (unsigned long long)(free_bytes / 1024), largest,
+		   free_blocks ? (double)free_bytes / free_blocks : 0,
+		   rss_kb(),
+		   latency[n_latency / 2] * tick_ns,
+		   latency[(uint32_t)(n_latency * 0.99)] * tick_ns,
+		   latency[(uint32_t)(n_latency * 0.999)] * tick_ns);
+	fflush(stdout);
+}
+
+int
+main(int argc, char **argv){
+
+	uint64_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+	uint32_t interval = n / SAMPLES ? n / SAMPLES : 1;
+	uint32_t *latency = malloc(interval * sizeof(uint32_t));
+	uint32_t n_latency = 0, units, flags = MM_FAMILY_WORST_FIT, i;
+	uint64_t cycle, live_bytes = 0, start;
+	double tick_ns = ns_per_tick();
+	family_t *family;
+	object_t object;
+
+	if(argc > 2){
+		for(i = 0; i < sizeof(policies) / sizeof(policies[0]); i++){
+			if(!strcmp(argv[2], policies[i].name))
+				break;
+		}
+		if(i == sizeof(policies) / sizeof(policies[0])){
+			printf("Error : unknown placement policy %s\n", argv[2]);
+			return 1;
+		}
+		flags = policies[i].flags;
+	}
+
+	mm_init();
+	for(i = 0; i < FAMILIES; i++)
+		families[i].handle = mm_instantiate_new_page_family_with_flags(
+					(char *)families[i].name, families[i].size, flags);
+
+	srand(1);
+	printf("cycle,live_kb,heap_kb,utilization,free_blocks,free_kb,largest,"
+		   "avg_free,rss_kb,p50_ns,p99_ns,p999_ns\n");
+
+	for(cycle = 1; cycle <= n; cycle++){
+
+		while(n_live && live[0].expiry <= cycle){
+			object = live_pop();
+			xfree(object.ptr);
+			live_bytes -= object.bytes;
+		}
+
+		family = pick_family();
+		units = 1 + rand() % family->max_units;
+
+		start = ticks();
+		object.ptr = xcalloc_family(family->handle, units);
+		latency[n_latency++] = (uint32_t)(ticks() - start);
+
+		if(!object.ptr){
+			printf("Error : out of memory at cycle %llu\n",
+				   (unsigned long long)cycle);
+			return 1;
+		}
+
+		object.bytes = units * family->size;
+		object.expiry = cycle + lifetime();
+		live_push(object);
+		live_bytes += object.bytes;
+
+		if(n_latency == interval){
+			sample(cycle, live_bytes, latency, n_latency, tick_ns);
+			n_latency = 0;
+		}
+	}
+
+	free(latency);
+	free(live);
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Bulk allocation benchmark.
+ *
+ * Allocates N objects in batches of B with a loop of xcalloc_family()
+ * calls and with one xcalloc_bulk() call per batch, then frees every
+ * batch, in a random order, with a loop of xfree() calls and with one
+ * xfree_bulk() call.
+ * Each run uses a family of its own so that both start from an empty
+ * heap.
+ *
+ *   ./bench_bulk [N] [B]
+ *
+ * Build : gcc -O2 -I. -Iglthread bench/bench_bulk.c mm.c \
+ *             glthread/glthread.c -o bench_bulk
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "uapi_mm.h"
+
+static double
+now_ns(){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+shuffle(void **objects, uint32_t n){
+
+	uint32_t i, j;
+	void *tmp;
+
+	for(i = n - 1; i > 0; i--){
+		j = rand() % (i + 1);
+		tmp = objects[i];
+		objects[i] = objects[j];
+		objects[j] = tmp;
+	}
+}
+
+static void
+run(uint32_t size, uint32_t n, uint32_t batch, int bulk, void **objects){
+
+	char family_name[32];
+	uint32_t i, count;
+	double start, alloc_ns, free_ns;
+
+	snprintf(family_name, sizeof(family_name), "bulk_%u_%d", size, bulk);
+	mm_family_t family = mm_instantiate_new_page_family(family_name, size);
+
+	start = now_ns();
+	for(i = 0; i < n; i += count){
+		count = n - i < batch ? n - i : batch;
+		if(bulk){
+			xcalloc_bulk(family, count, objects + i);
+		}
+		else{
+			uint32_t j;
+			for(j = 0; j < count; j++)
+				objects[i + j] = xcalloc_family(family, 1);
+		}
+	}
+	alloc_ns = (now_ns() - start) / n;
+
+	/*Free each batch in a random order*/
+	srand(1);
+	for(i = 0; i < n; i += batch)
+		shuffle(objects + i, n - i < batch ? n - i : batch);
+
+	start = now_ns();
+	for(i = 0; i < n; i += count){
+		count = n - i < batch ? n - i : batch;
+		if(bulk){
+			xfree_bulk(objects + i, count);
+		}
+		else{
+			uint32_t j;
+			for(j = 0; j < count; j++)
+				xfree(objects[i + j]);
+		}
+	}
+	free_ns = (now_ns() - start) / n;
+
+	printf("%-8u %-8s %-16.1f %-16.1f\n", size, bulk ? "bulk" : "loop",
+		   alloc_ns, free_ns);
+}
+
+int
+main(int argc, char **argv){
+
+	uint32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+	uint32_t batch = argc > 2 ? atoi(argv[2]) : 256;
+	uint32_t sizes[] = {32, 128, 512};
+	uint32_t s;
+	void **objects = malloc(n * sizeof(void *));
+
+	mm_init();
+
+	printf("batch %u\n", batch);
+	printf("%-8s %-8s %-16s %-16s\n", "size", "mode", "alloc_ns_per_obj",
+		   "free_ns_per_obj");
+
+	for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+		run(sizes[s], n, batch, 0, objects);
+		run(sizes[s], n, batch, 1, objects);
+	}
+
+	free(objects);
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Heap growth benchmark.
+ *
+ * Fills several page families with N objects each, reporting the time
+ * the fill took and the number of mappings (VMAs) of the process before
+ * and after, read from /proc/self/maps, then again once the first family
+ * is freed. Spans are carved from chunks, so the heap should grow by a
+ * handful of mappings rather than one per page, and releasing pages
+ * should not punch holes splitting them.
+ *
+ * Build : gcc -O2 -I. -Iglthread bench/bench_chunk_fill.c mm.c \
+ *             glthread/glthread.c -o bench_chunk_fill
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "uapi_mm.h"
+
+#define FAMILIES	4
+
+static double
+now_ns(){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t
+vma_count(){
+
+	FILE *maps = fopen("/proc/self/maps", "r");
+	uint32_t count = 0;
+	int c;
+
+	if(!maps)
+		return 0;
+	while((c = fgetc(maps)) != EOF){
+		if(c == '\n')
+			count++;
+	}
+	fclose(maps);
+	return count;
+}
+
+int
+main(int argc, char **argv){
+
+	uint32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+	uint32_t object_sizes[FAMILIES] = {24, 64, 200, 1000};
+	mm_family_t families[FAMILIES];
+	char family_name[32];
+	uint32_t i, j, vmas_before;
+	void **first_family_objects;
+	double start, fill_ms;
+
+	mm_init();
+
+	for(j = 0; j < FAMILIES; j++){
+		snprintf(family_name, sizeof(family_name), "fill_%u", object_sizes[j]);
+		families[j] = mm_instantiate_new_page_family(family_name, object_sizes[j]);
+	}
+
+	first_family_objects = calloc(n, sizeof(void *));
+	vmas_before = vma_count();
+
+	/*Interleave the families like an application would*/
+	start = now_ns();
+	for(i = 0; i < n; i++){
+		first_family_objects[i] = xcalloc_family(families[0], 1);
+		for(j = 1; j < FAMILIES; j++)
+			xcalloc_family(families[j], 1);
+	}
+	fill_ms = (now_ns() - start) / 1e6;
+
+	printf("objects_per_family %u\n", n);
+	printf("fill_ms            %.1f\n", fill_ms);
+	printf("ns_per_object      %.1f\n", fill_ms * 1e6 / ((double)n * FAMILIES));
+	printf("vmas_before        %u\n", vmas_before);
+	printf("vmas_after         %u\n", vma_count());
+
+	for(i = 0; i < n; i++)
+		xfree(first_family_objects[i]);
+	printf("vmas_after_free    %u\n", vma_count());
+
+	free(first_family_objects);
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * False sharing benchmark.
+ *
+ * Every thread owns one counter and increments it in a loop, the way
+ * per thread statistics are kept. The counters are allocated one after
+ * the other by the main thread, as at start up, from three page families
+ * registered with the same structure :
+ *
+ *   plain    no flag, counters are packed next to each other
+ *   aligned  MM_FAMILY_CACHE_ALIGNED, every counter starts a cache line
+ *   padded   MM_FAMILY_CACHE_PADDED, every counter owns its cache lines
+ *
+ * and once more with xcalloc_aligned() from the plain family. Packed
+ * counters share cache lines which then bounce between the cores of the
+ * threads incrementing them, the increments of the other families run
+ * at the speed of a single thread.
+ *
+ * Build : gcc -O2 -pthread -I. -Iglthread bench/bench_false_sharing.c \
+ *             mm.c glthread/glthread.c -o bench_false_sharing
+ * Run   : ./bench_false_sharing [threads] [increments_per_thread]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "uapi_mm.h"
+
+#define MAX_THREADS	64
+
+typedef struct counter_ {
+	
+	volatile uint64_t count;
+	
+} counter_t;
+
+static long increments_per_thread;
+
+static double
+now_sec(){
+	
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *
+worker(void *arg){
+	
+	counter_t *counter = (counter_t *)arg;
+	long i;
+	
+	for(i = 0; i < increments_per_thread; i++)
+		counter->count++;
+	return NULL;
+}
+
+/*Returns the nanoseconds per increment, cache_lines counts the distinct
+  cache lines holding the counters*/
+static double
+run(mm_family_t family, uint32_t align, int n_threads, int *cache_lines){
+	
+	pthread_t threads[MAX_THREADS];
+	counter_t *counters[MAX_THREADS];
+	double start;
+	int i, j;
+	
+	for(i = 0; i < n_threads; i++){
+		counters[i] = align ? xcalloc_aligned(family, 1, align) :
+							  xcalloc_family(family, 1);
+	}
+	
+	*cache_lines = 0;
+	for(i = 0; i < n_threads; i++){
+		for(j = 0; j < i; j++){
+			if((uintptr_t)counters[i] / MM_CACHE_LINE_SIZE ==
+				(uintptr_t)counters[j] / MM_CACHE_LINE_SIZE)
+				break;
+		}
+		if(j == i)
+			(*cache_lines)++;
+	}
+	
+	start = now_sec();
+	for(i = 0; i < n_threads; i++)
+		pthread_create(&threads[i], NULL, worker, counters[i]);
+	for(i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+	start = now_sec() - start;
+	
+	for(i = 0; i < n_threads; i++)
+		xfree(counters[i]);
+	
+	return start * 1e9 / increments_per_thread;
+}
+
+int
+main(int argc, char **argv){
+	
+	int n_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	mm_family_t plain, aligned, padded;
+	int cache_lines;
+	double ns;
+	
+	increments_per_thread = argc > 2 ? atol(argv[2]) : 100000000;
+	
+	if(n_threads > MAX_THREADS)
+		n_threads = MAX_THREADS;
+	
+	mm_init();
+	plain = mm_instantiate_new_page_family("counter_t", sizeof(counter_t));
+	aligned = mm_instantiate_new_page_family_with_flags("counter_t_aligned",
+				sizeof(counter_t), MM_FAMILY_CACHE_ALIGNED);
+	padded = mm_instantiate_new_page_family_with_flags("counter_t_padded",
+				sizeof(counter_t), MM_FAMILY_CACHE_PADDED);
+	
+	printf("%d threads, %ld increments each\n", n_threads, increments_per_thread);
+	printf("%-16s %-12s %-12s\n", "family", "cache_lines", "ns_per_inc");
+	
+	ns = run(plain, 0, n_threads, &cache_lines);
+	printf("%-16s %-12d %-12.2f\n", "plain", cache_lines, ns);
+	ns = run(aligned, 0, n_threads, &cache_lines);
+	printf("%-16s %-12d %-12.2f\n", "aligned", cache_lines, ns);
+	ns = run(padded, 0, n_threads, &cache_lines);
+	printf("%-16s %-12d %-12.2f\n", "padded", cache_lines, ns);
+	ns = run(plain, MM_CACHE_LINE_SIZE, n_threads, &cache_lines);
+	printf("%-16s %-12d %-12.2f\n", "xcalloc_aligned", cache_lines, ns);
+	return 0;
+}
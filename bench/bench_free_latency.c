@@ -0,0 +1,70 @@
+/*
+ * Free block list latency benchmark.
+ *
+ * For a growing number N of free blocks in one page family, measures the
+ * average cost of xfree() while the free block lists fill up to N entries
+ * and of xcalloc() while they drain again. With segregated size class
+ * lists both should stay flat as N grows.
+ *
+ * Build : gcc -O2 -I. -Iglthread bench/bench_free_latency.c mm.c \
+ *             glthread/glthread.c -o bench_free_latency
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "uapi_mm.h"
+
+#define OBJECT_SIZE	40
+
+static double
+now_ns(){
+	
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(int argc, char **argv){
+	
+	uint32_t n, i;
+	uint32_t max_free_blocks = argc > 1 ? atoi(argv[1]) : 65536;
+	char family_name[32];
+	void **objects;
+	double start, free_ns, alloc_ns;
+	
+	mm_init();
+	
+	objects = calloc(2 * max_free_blocks, sizeof(void *));
+	
+	printf("%-12s %-14s %-14s\n", "free_blocks", "ns_per_xfree", "ns_per_xcalloc");
+	
+	for(n = 1024; n <= max_free_blocks; n *= 2){
+		
+		snprintf(family_name, sizeof(family_name), "bench_%u", n);
+		mm_family_t family = mm_instantiate_new_page_family(family_name, OBJECT_SIZE);
+		
+		for(i = 0; i < 2 * n; i++)
+			objects[i] = xcalloc_family(family, 1);
+		
+		/*Freeing every other object leaves n free blocks that cannot
+		  be coalesced with their allocated neighbours*/
+		start = now_ns();
+		for(i = 1; i < 2 * n; i += 2)
+			xfree(objects[i]);
+		free_ns = (now_ns() - start) / n;
+		
+		start = now_ns();
+		for(i = 1; i < 2 * n; i += 2)
+			objects[i] = xcalloc_family(family, 1);
+		alloc_ns = (now_ns() - start) / n;
+		
+		printf("%-12u %-14.1f %-14.1f\n", n, free_ns, alloc_ns);
+		
+		for(i = 0; i < 2 * n; i++)
+			xfree(objects[i]);
+	}
+	
+	free(objects);
+	return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Huge page backing benchmark.
+ *
+ * Builds a list of N student_t like nodes linked in random order, so
+ * that every hop lands on an unrelated page, then times a number of
+ * passes over it. dTLB load misses are read with perf_event_open() when
+ * the kernel allows it. Run once per backing and compare :
+ *
+ *   ./bench_huge_pages off 4000000
+ *   ./bench_huge_pages thp 4000000
+ *   ./bench_huge_pages hugetlb 4000000   (needs /proc/sys/vm/nr_hugepages)
+ *
+ * Build : gcc -O2 -I. -Iglthread bench/bench_huge_pages.c mm.c \
+ *             glthread/glthread.c -o bench_huge_pages
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "uapi_mm.h"
+
+#define PASSES	4
+
+typedef struct student_ {
+
+	char name[32];
+	uint32_t rollno;
+	uint32_t marks_phys;
+	uint32_t marks_chem;
+	uint32_t marks_math;
+	struct student_ *next;
+} student_t;
+
+static double
+now_ns(){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*-1 when perf events are not available*/
+static int
+dtlb_miss_counter_open(){
+
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_DTLB |
+				  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+				  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static unsigned long
+anon_huge_kb(){
+
+	FILE *smaps = fopen("/proc/self/smaps_rollup", "r");
+	char line[256];
+	unsigned long kb = 0;
+
+	if(!smaps)
+		return 0;
+	while(fgets(line, sizeof(line), smaps)){
+		if(sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+			break;
+	}
+	fclose(smaps);
+	return kb;
+}
+
+int
+main(int argc, char **argv){
+
+	const char *backing = argc > 1 ? argv[1] : "off";
+	uint32_t n = argc > 2 ? atoi(argv[2]) : 2000000;
+	mm_huge_pages_t huge_pages = MM_HUGE_PAGES_OFF;
+	student_t **nodes, *head, *curr;
+	uint32_t i, j, pass, checksum = 0;
+	long long misses = -1;
+	int counter;
+	double start, chase_ns;
+
+	if(!strcmp(backing, "thp"))
+		huge_pages = MM_HUGE_PAGES_THP;
+	else if(!strcmp(backing, "hugetlb"))
+		huge_pages = MM_HUGE_PAGES_HUGETLB;
+
+	mm_init();
+	mm_family_t family = MM_REG_STRUCT(student_t);
+	mm_family_set_huge_pages(family, huge_pages);
+
+	nodes = malloc(n * sizeof(student_t *));
+	for(i = 0; i < n; i++){
+		nodes[i] = xcalloc_family(family, 1);
+		nodes[i]->rollno = i;
+	}
+
+	/*Link the nodes in a random order*/
+	srand(1);
+	for(i = n - 1; i > 0; i--){
+		j = rand() % (i + 1);
+		curr = nodes[i];
+		nodes[i] = nodes[j];
+		nodes[j] = curr;
+	}
+	for(i = 0; i + 1 < n; i++)
+		nodes[i]->next = nodes[i + 1];
+	nodes[n - 1]->next = NULL;
+	head = nodes[0];
+
+	counter = dtlb_miss_counter_open();
+	if(counter >= 0){
+		ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	start = now_ns();
+	for(pass = 0; pass < PASSES; pass++){
+		for(curr = head; curr; curr = curr->next)
+			checksum += curr->rollno;
+	}
+	chase_ns = now_ns() - start;
+
+	if(counter >= 0){
+		ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+		if(read(counter, &misses, sizeof(misses)) != sizeof(misses))
+			misses = -1;
+		close(counter);
+	}
+
+	printf("backing            %s\n", backing);
+	printf("nodes              %u\n", n);
+	printf("anon_huge_kb       %lu\n", anon_huge_kb());
+	printf("ns_per_hop         %.2f\n", chase_ns / ((double)n * PASSES));
+	printf("mhops_per_sec      %.1f\n", (double)n * PASSES * 1e3 / chase_ns);
+	if(misses >= 0)
+		printf("dtlb_misses_per_hop %.3f\n", (double)misses / ((double)n * PASSES));
+	else
+		printf("dtlb_misses_per_hop n/a\n");
+	printf("checksum           %u\n", checksum);
+
+	free(nodes);
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Multi threaded scaling benchmark.
+ *
+ * Every thread repeatedly allocates a batch of objects from a shared page
+ * family and frees them again. The same workload runs through the per
+ * thread magazines of a MM_THREAD_SAFE build and through one global mutex
+ * wrapped around every XCALLOC/XFREE, for 1 to N threads.
+ *
+ * Build : gcc -O2 -DMM_THREAD_SAFE -pthread -I. -Iglthread \
+ *             bench/bench_mt_scaling.c mm.c glthread/glthread.c \
+ *             -o bench_mt_scaling
+ * Run   : ./bench_mt_scaling [max_threads] [ops_per_thread]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "uapi_mm.h"
+
+#define BATCH	16
+
+typedef struct emp_ {
+	
+	char name[32];
+	uint32_t emp_id;
+	
+} emp_t;
+
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+static int use_global_lock;
+static long ops_per_thread;
+
+static double
+now_sec(){
+	
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *
+worker(void *arg){
+	
+	emp_t *objects[BATCH];
+	long op;
+	int i;
+	
+	for(op = 0; op < ops_per_thread; op += BATCH){
+		
+		for(i = 0; i < BATCH; i++){
+			if(use_global_lock) pthread_mutex_lock(&global_lock);
+			objects[i] = XCALLOC(1, emp_t);
+			if(use_global_lock) pthread_mutex_unlock(&global_lock);
+			objects[i]->emp_id = i;
+		}
+		
+		for(i = 0; i < BATCH; i++){
+			if(use_global_lock) pthread_mutex_lock(&global_lock);
+			XFREE(objects[i]);
+			if(use_global_lock) pthread_mutex_unlock(&global_lock);
+		}
+	}
+	
+	mm_thread_cache_flush();
+	return NULL;
+}
+
+static double
+run(int n_threads){
+	
+	pthread_t threads[n_threads];
+	double start = now_sec();
+	int i;
+	
+	for(i = 0; i < n_threads; i++)
+		pthread_create(&threads[i], NULL, worker, NULL);
+	for(i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+	
+	/*Alloc and free both count as one operation*/
+	return 2.0 * n_threads * ops_per_thread / (now_sec() - start);
+}
+
+int
+main(int argc, char **argv){
+	
+	int max_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int n_threads;
+	
+	ops_per_thread = argc > 2 ? atol(argv[2]) : 2000000;
+	
+	mm_init();
+	MM_REG_STRUCT(emp_t);
+	
+	printf("%-8s %-18s %-18s %-8s\n", "threads", "magazine_mops", "global_lock_mops",
+			"speedup");
+	
+	for(n_threads = 1; n_threads <= max_threads; n_threads *= 2){
+		
+		use_global_lock = 0;
+		double magazine = run(n_threads);
+		use_global_lock = 1;
+		double global = run(n_threads);
+		
+		printf("%-8d %-18.2f %-18.2f %-8.2f\n", n_threads, magazine / 1e6,
+				global / 1e6, magazine / global);
+		
+		if(n_threads < max_threads && n_threads * 2 > max_threads)
+			n_threads = max_threads / 2;
+	}
+	return 0;
+}
@@ -0,0 +1,474 @@
+/*
+ * Allocator benchmark suite.
+ *
+ * Runs a set of workloads through XCALLOC/XFREE and through glibc
+ * calloc/free :
+ *
+ *   fixed        N 64 byte objects each freed right after allocation
+ *   churn        N random alloc or free steps over a working set of
+ *                N/4 slots, sizes drawn from 8 classes of 16 to 1024 bytes
+ *   free_lifo    N 64 byte objects freed in reverse allocation order
+ *   free_fifo    N 64 byte objects freed in allocation order
+ *   free_random  N 64 byte objects freed in a random order
+ *   list         a list of N 64 byte nodes built, walked 4 times, freed
+ *
+ * Every workload runs in a child process of its own, so that peak RSS
+ * is that of the workload alone. It runs twice, once untimed for the
+ * throughput and once with every operation timed for the latency
+ * percentiles. Output is one CSV line per workload and allocator :
+ *
+ *   workload,allocator,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,
+ *   peak_rss_kb,heap_kb,mm_pages_in_use
+ *
+ * heap_kb is the heap at its fullest as the allocator accounts for it,
+ * mm_get_memory_usage() pages in use and cached for the memory manager,
+ * mallinfo2() for glibc. mm_pages_in_use is -1 for glibc. The arrays of
+ * the harness are mapped directly, they add 16 bytes per object to the
+ * peak RSS of both allocators.
+ *
+ *   ./bench_suite [N] [workload]
+ *
+ * Build : gcc -O2 -I. -Iglthread bench/bench_suite.c mm.c \
+ *             glthread/glthread.c -o bench_suite
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "uapi_mm.h"
+
+#define SIZE_CLASSES	8
+#define LIST_PASSES		4
+
+typedef struct obj16_  { char data[16];   } obj16_t;
+typedef struct obj32_  { char data[32];   } obj32_t;
+typedef struct obj48_  { char data[48];   } obj48_t;
+typedef struct obj64_  { char data[64];   } obj64_t;
+typedef struct obj128_ { char data[128];  } obj128_t;
+typedef struct obj256_ { char data[256];  } obj256_t;
+typedef struct obj512_ { char data[512];  } obj512_t;
+typedef struct obj1024_{ char data[1024]; } obj1024_t;
+
+typedef struct node_ {
+
+	struct node_ *next;
+	uint64_t value;
+	char pad[48];
+} node_t;
+
+static const uint32_t class_sizes[SIZE_CLASSES] =
+	{16, 32, 48, 64, 128, 256, 512, 1024};
+
+typedef struct allocator_ {
+
+	const char *name;
+	void *(*alloc)(uint32_t size_class);
+	void *(*alloc_node)(void);
+	void (*release)(void *ptr);
+	void (*heap_usage)(uint64_t *heap_kb, long *mm_pages);
+} allocator_t;
+
+/*Memory manager, through the per call site cached macros*/
+static void *
+mm_alloc(uint32_t size_class){
+
+	switch(size_class){
+		case 0: return XCALLOC(1, obj16_t);
+		case 1: return XCALLOC(1, obj32_t);
+		case 2: return XCALLOC(1, obj48_t);
+		case 3: return XCALLOC(1, obj64_t);
+		case 4: return XCALLOC(1, obj128_t);
+		case 5: return XCALLOC(1, obj256_t);
+		case 6: return XCALLOC(1, obj512_t);
+		default: return XCALLOC(1, obj1024_t);
+	}
+}
+
+static void *
+mm_alloc_node(void){
+
+	return XCALLOC(1, node_t);
+}
+
+static void
+mm_release(void *ptr){
+
+	XFREE(ptr);
+}
+
+static void
+mm_heap_usage(uint64_t *heap_kb, long *mm_pages){
+
+	mm_memory_usage_t usage;
+
+	mm_get_memory_usage(NULL, &usage);
+	*heap_kb = ((uint64_t)usage.vm_pages_in_use + usage.vm_pages_cached) *
+				getpagesize() / 1024;
+	*mm_pages = usage.vm_pages_in_use;
+}
+
+/*glibc*/
+static void *
+libc_alloc(uint32_t size_class){
+
+	return calloc(1, class_sizes[size_class]);
+}
+
+static void *
+libc_alloc_node(void){
+
+	return calloc(1, sizeof(node_t));
+}
+
+static void
+libc_release(void *ptr){
+
+	free(ptr);
+}
+
+static void
+libc_heap_usage(uint64_t *heap_kb, long *mm_pages){
+
+	struct mallinfo2 info = mallinfo2();
+
+	*heap_kb = (info.arena + info.hblkhd) / 1024;
+	*mm_pages = -1;
+}
+
+static const allocator_t allocators[] = {
+	{"mm",    mm_alloc,   mm_alloc_node,   mm_release,   mm_heap_usage},
+	{"glibc", libc_alloc, libc_alloc_node, libc_release, libc_heap_usage},
+};
+
+/*Per operation timing, with the time stamp counter where there is one*/
+static inline uint64_t
+ticks(){
+
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static double
+now_ns(){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double
+ns_per_tick(){
+
+	double start_ns = now_ns(), end_ns;
+	uint64_t start = ticks();
+
+	do{
+		end_ns = now_ns();
+	} while(end_ns - start_ns < 50e6);
+	return (end_ns - start_ns) / (double)(ticks() - start);
+}
+
+typedef struct run_ {
+
+	const allocator_t *allocator;
+	uint32_t n;
+	uint32_t *latency;	/*NULL for the untimed run*/
+	uint64_t n_ops;
+	uint64_t heap_kb;
+	long mm_pages;
+} run_t;
+
+/*Run op, timing it when the run is timed*/
+#define RUN_OP(run, op)												\
+	do{																\
+		if((run)->latency){											\
+			uint64_t _start = ticks();								\
+			op;														\
+			(run)->latency[(run)->n_ops] = (uint32_t)(ticks() - _start);\
+		}															\
+		else{														\
+			op;														\
+		}															\
+		(run)->n_ops++;												\
+	} while(0)
+
+static void
+sample_heap(run_t *run){
+
+	uint64_t heap_kb;
+	long mm_pages;
+
+	run->allocator->heap_usage(&heap_kb, &mm_pages);
+	if(heap_kb > run->heap_kb)
+		run->heap_kb = heap_kb;
+	if(mm_pages > run->mm_pages)
+		run->mm_pages = mm_pages;
+}
+
+static void
+shuffle(void **objects, uint32_t n){
+
+	uint32_t i, j;
+	void *tmp;
+
+	for(i = n - 1; i > 0; i--){
+		j = rand() % (i + 1);
+		tmp = objects[i];
+		objects[i] = objects[j];
+		objects[j] = tmp;
+	}
+}
+
+typedef enum{
+	FREE_LIFO,
+	FREE_FIFO,
+	FREE_RANDOM
+} free_order_t;
+
+static void
+fill_and_free(run_t *run, void **objects, free_order_t order){
+
+	const allocator_t *allocator = run->allocator;
+	uint32_t i, n = run->n;
+
+	for(i = 0; i < n; i++)
+		RUN_OP(run, objects[i] = allocator->alloc(3));
+
+	sample_heap(run);
+
+	if(order == FREE_RANDOM)
+		shuffle(objects, n);
+
+	for(i = 0; i < n; i++){
+		void *ptr = objects[order == FREE_LIFO ? n - 1 - i : i];
+		RUN_OP(run, allocator->release(ptr));
+	}
+}
+
+static void
+workload_fixed(run_t *run, void **objects){
+
+	const allocator_t *allocator = run->allocator;
+	uint32_t i;
+
+	for(i = 0; i < run->n; i++){
+		RUN_OP(run, objects[0] = allocator->alloc(3));
+		if(!i)
+			sample_heap(run);
+		RUN_OP(run, allocator->release(objects[0]));
+	}
+}
+
+static void
+workload_free_lifo(run_t *run, void **objects){
+
+	fill_and_free(run, objects, FREE_LIFO);
+}
+
+static void
+workload_free_fifo(run_t *run, void **objects){
+
+	fill_and_free(run, objects, FREE_FIFO);
+}
+
+static void
+workload_free_random(run_t *run, void **objects){
+
+	fill_and_free(run, objects, FREE_RANDOM);
+}
+
+static void
+workload_churn(run_t *run, void **objects){
+
+	const allocator_t *allocator = run->allocator;
+	uint32_t slots = run->n / 4 ? run->n / 4 : 1;
+	uint32_t i, slot;
+
+	memset(objects, 0, slots * sizeof(void *));
+
+	for(i = 0; i < run->n; i++){
+		slot = rand() % slots;
+		if(objects[slot]){
+			RUN_OP(run, allocator->release(objects[slot]));
+			objects[slot] = NULL;
+		}
+		else{
+			uint32_t size_class = rand() % SIZE_CLASSES;
+			RUN_OP(run, objects[slot] = allocator->alloc(size_class));
+		}
+	}
+
+	sample_heap(run);
+
+	for(slot = 0; slot < slots; slot++){
+		if(objects[slot])
+			RUN_OP(run, allocator->release(objects[slot]));
+	}
+}
+
+static volatile uint64_t list_sum;
+
+/*Traversals are not allocator operations, they only show in ops_per_sec*/
+static void
+workload_list(run_t *run, void **objects){
+
+	const allocator_t *allocator = run->allocator;
+	node_t *head = NULL, *node, *next;
+	uint64_t sum = 0;
+	uint32_t i, pass;
+
+	for(i = 0; i < run->n; i++){
+		RUN_OP(run, node = allocator->alloc_node());
+		node->value = i;
+		node->next = head;
+		head = node;
+	}
+
+	sample_heap(run);
+
+	for(pass = 0; pass < LIST_PASSES; pass++){
+		for(node = head; node; node = node->next)
+			sum += node->value;
+	}
+	list_sum = sum;
+
+	for(node = head; node; node = next){
+		next = node->next;
+		RUN_OP(run, allocator->release(node));
+	}
+}
+
+typedef struct workload_ {
+
+	const char *name;
+	void (*fn)(run_t *run, void **objects);
+} workload_t;
+
+static const workload_t workloads[] = {
+	{"fixed",       workload_fixed},
+	{"churn",       workload_churn},
+	{"free_lifo",   workload_free_lifo},
+	{"free_fifo",   workload_free_fifo},
+	{"free_random", workload_free_random},
+	{"list",        workload_list},
+};
+
+static int
+compare_latency(const void *a, const void *b){
+
+	uint32_t first = *(const uint32_t *)a, second = *(const uint32_t *)b;
+
+	return first < second ? -1 : first > second;
+}
+
+static double
+percentile(uint32_t *sorted, uint64_t n, double fraction){
+
+	uint64_t index = (uint64_t)(fraction * (n - 1));
+
+	return sorted[index];
+}
+
+/*Child process body : one workload through one allocator*/
+static void
+run_workload(const workload_t *workload, const allocator_t *allocator,
+			 uint32_t n, double tick_ns){
+
+	size_t objects_size = n * sizeof(void *);
+	/*No workload runs more than 2 operations per object*/
+	size_t latency_size = (size_t)n * 2 * sizeof(uint32_t);
+	void **objects = mmap(NULL, objects_size, PROT_READ | PROT_WRITE,
+						  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	uint32_t *latency = mmap(NULL, latency_size, PROT_READ | PROT_WRITE,
+							 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	run_t run;
+	double start, elapsed_ns;
+	struct rusage usage;
+
+	memset(&run, 0, sizeof(run));
+	run.allocator = allocator;
+	run.n = n;
+	run.mm_pages = -1;
+
+	srand(1);
+	start = now_ns();
+	workload->fn(&run, objects);
+	elapsed_ns = now_ns() - start;
+
+	/*Fault the samples in before they are timed*/
+	memset(latency, 0, latency_size);
+	run.n_ops = 0;
+	run.latency = latency;
+	srand(1);
+	workload->fn(&run, objects);
+
+	qsort(latency, run.n_ops, sizeof(uint32_t), compare_latency);
+	getrusage(RUSAGE_SELF, &usage);
+
+	printf("%s,%s,%llu,%.0f,%.1f,%.1f,%.1f,%ld,%llu,%ld\n",
+		   workload->name, allocator->name, (unsigned long long)run.n_ops,
+		   run.n_ops * 1e9 / elapsed_ns,
+		   percentile(latency, run.n_ops, 0.50) * tick_ns,
+		   percentile(latency, run.n_ops, 0.99) * tick_ns,
+		   percentile(latency, run.n_ops, 0.999) * tick_ns,
+		   usage.ru_maxrss, (unsigned long long)run.heap_kb, run.mm_pages);
+	fflush(stdout);
+
+	munmap(latency, latency_size);
+	munmap(objects, objects_size);
+}
+
+int
+main(int argc, char **argv){
+
+	uint32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+	const char *only = argc > 2 ? argv[2] : NULL;
+	double tick_ns = ns_per_tick();
+	uint32_t w, a;
+	pid_t pid;
+
+	mm_init();
+	MM_REG_STRUCT(obj16_t);
+	MM_REG_STRUCT(obj32_t);
+	MM_REG_STRUCT(obj48_t);
+	MM_REG_STRUCT(obj64_t);
+	MM_REG_STRUCT(obj128_t);
+	MM_REG_STRUCT(obj256_t);
+	MM_REG_STRUCT(obj512_t);
+	MM_REG_STRUCT(obj1024_t);
+	MM_REG_STRUCT(node_t);
+
+	printf("workload,allocator,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,"
+		   "peak_rss_kb,heap_kb,mm_pages_in_use\n");
+	fflush(stdout);
+
+	for(w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++){
+
+		if(only && strcmp(only, workloads[w].name))
+			continue;
+
+		for(a = 0; a < sizeof(allocators) / sizeof(allocators[0]); a++){
+
+			pid = fork();
+			if(pid == 0){
+				run_workload(&workloads[w], &allocators[a], n, tick_ns);
+				exit(0);
+			}
+			if(pid < 0 || waitpid(pid, NULL, 0) < 0){
+				perror("fork");
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
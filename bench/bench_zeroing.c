@@ -0,0 +1,85 @@
+/*
+ * Zeroing cost benchmark.
+ *
+ * Allocates N objects of a few sizes with xcalloc and with xmalloc,
+ * first from a fresh heap, where xcalloc can skip memory known to be
+ * zero, then from a recycled heap, where every object was written and
+ * freed before.
+ *
+ * Build : gcc -O2 -I. -Iglthread bench/bench_zeroing.c mm.c \
+ *             glthread/glthread.c -o bench_zeroing
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "uapi_mm.h"
+
+static double
+now_ns(){
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double
+fill(mm_family_t family, void **objects, uint32_t n, int zero){
+
+	uint32_t i;
+	double start = now_ns();
+
+	for(i = 0; i < n; i++){
+		objects[i] = zero ? xcalloc_family(family, 1) :
+							xmalloc_family(family, 1);
+	}
+	return (now_ns() - start) / n;
+}
+
+static void
+release(mm_family_t family, void **objects, uint32_t n, uint32_t size){
+
+	uint32_t i;
+
+	for(i = 0; i < n; i++){
+		memset(objects[i], 0xa5, size);
+		xfree(objects[i]);
+	}
+}
+
+int
+main(int argc, char **argv){
+
+	uint32_t n = argc > 1 ? atoi(argv[1]) : 200000;
+	uint32_t sizes[] = {64, 512, 2048};
+	uint32_t s;
+	int zero;
+	char family_name[32];
+	void **objects = malloc(n * sizeof(void *));
+	double fresh_ns, recycled_ns;
+
+	mm_init();
+
+	printf("%-8s %-8s %-16s %-16s\n", "size", "alloc", "fresh_ns_per_op",
+		   "recycled_ns_per_op");
+
+	for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+		for(zero = 1; zero >= 0; zero--){
+
+			/*A family of its own, so that the fresh run gets fresh pages*/
+			snprintf(family_name, sizeof(family_name), "zero_%u_%d", sizes[s], zero);
+			mm_family_t family = mm_instantiate_new_page_family(family_name, sizes[s]);
+
+			fresh_ns = fill(family, objects, n, zero);
+			release(family, objects, n, sizes[s]);
+			recycled_ns = fill(family, objects, n, zero);
+			release(family, objects, n, sizes[s]);
+
+			printf("%-8u %-8s %-16.1f %-16.1f\n", sizes[s],
+				   zero ? "xcalloc" : "xmalloc", fresh_ns, recycled_ns);
+		}
+	}
+
+	free(objects);
+	return 0;
+}
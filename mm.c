@@ -1,9 +1,20 @@
+#define _GNU_SOURCE	/*for mremap()*/
 #include <stdio.h>
+#include <stdlib.h>	/*for qsort*/
 #include <memory.h>
 #include <unistd.h>     /*for getpagesize*/
 #include <sys/mman.h>   /*for using mmap()*/
+#include <sys/syscall.h>	/*for mbind()*/
+#include <fcntl.h>
+#ifdef MM_HEAP_PROFILE
+#include <execinfo.h>	/*for backtrace()*/
+#include <dlfcn.h>		/*for dladdr()*/
+#endif
+#include <sched.h>		/*for getcpu()*/
 #include <assert.h>
+#include <time.h>
 #include "mm.h"
+#include "uapi_mm.h"
 
 
 #define ANSI_COLOR_MAGENTA "\x1b[35m"
@@ -12,10 +23,65 @@
 
 static vm_page_for_families_t *first_vm_page_for_families = NULL;
 static size_t SYSTEM_PAGE_SIZE = 0;
+static uint32_t SYSTEM_PAGE_SHIFT = 0;
+
+/*System pages per span of families registered from now on*/
+static uint32_t default_span_units = 1;
+
+static vm_page_t **mm_pagemap_root[MM_PAGEMAP_ROOT_SIZE];
+
+/*Page family registry : open addressed (linear probing) index over the
+  struct_name of every registered page family. The table is sized in
+  whole VM pages and doubled once it is half full*/
+static vm_page_family_t **page_family_registry = NULL;
+static uint32_t page_family_registry_size = 0;		/*number of slots, power of 2*/
+static uint32_t page_family_registry_count = 0;
+static uint32_t families_in_first_vm_page_for_families = 0;
+static uint32_t n_page_families = 0;	/*registered and per NUMA node ones*/
+
+/*Online NUMA nodes below MM_NUMA_MAX_NODES, see mm_numa_init()*/
+static uint32_t numa_online_nodes = 0;
+static uint32_t numa_n_nodes = 0;
+
+/*Empty page cache shared by all page families, see
+  mm_set_page_cache_watermarks()*/
+static vm_page_t *global_empty_pages = NULL;
+static uint32_t n_global_empty_pages = 0;
+static uint32_t global_empty_pages_low = MM_GLOBAL_PAGE_CACHE_LOW;
+static uint32_t global_empty_pages_high = MM_GLOBAL_PAGE_CACHE_HIGH;
+static mm_page_release_mode_t page_release_mode = MM_PAGE_RELEASE_MADV_DONTNEED;
+
+/*Chunks of internal pages, never released*/
+static mm_chunk_t *internal_chunks = NULL;
+static uint32_t internal_next_chunk_units = 0;
+static uint32_t n_chunks = 0;
+static uint64_t chunk_reserved_units = 0;
+
+/*All arenas, newest first, see mm_arena_create()*/
+static vm_arena_t *arenas = NULL;
+
+#ifdef MM_THREAD_SAFE
+static pthread_mutex_t mm_pagemap_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t global_page_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t mm_chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t mm_arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t page_family_registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+#define MM_REGISTRY_RDLOCK()	pthread_rwlock_rdlock(&page_family_registry_lock)
+#define MM_REGISTRY_WRLOCK()	pthread_rwlock_wrlock(&page_family_registry_lock)
+#define MM_REGISTRY_UNLOCK()	pthread_rwlock_unlock(&page_family_registry_lock)
+#else
+#define MM_REGISTRY_RDLOCK()
+#define MM_REGISTRY_WRLOCK()
+#define MM_REGISTRY_UNLOCK()
+#endif
+
+static void mm_numa_init();
 
 void mm_init()
 {
 	SYSTEM_PAGE_SIZE = getpagesize();
+	SYSTEM_PAGE_SHIFT = __builtin_ctzl(SYSTEM_PAGE_SIZE);
+	mm_numa_init();
 }
 
 /*Function to request VM page from kernel*/
@@ -32,7 +98,7 @@ static void * mm_get_new_vm_page_from_kernel(int units){
 		printf("Error : VM Page allocation Failed\n");
 		return NULL;
 	}
-	memset(vm_page, 0, units * SYSTEM_PAGE_SIZE);
+	/*Anonymous mappings are zero filled by the kernel on first touch*/
 	return (void *)vm_page;
 }
 
@@ -44,531 +110,4360 @@ static void mm_return_vm_page_to_kernel(void *vm_page, int units){
 	}
 }
 
-void mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size){
+/*NUMA : nodes are read from sysfs, no libnuma needed. Without it, as in
+  most containers, the machine is taken for a single node one*/
+#define MM_NUMA_ONLINE_NODES	"/sys/devices/system/node/online"
+#define MM_MPOL_PREFERRED		1
+
+/*Parse the node list, like "0-1,3". No stdio, mm_init() may run inside
+  the first malloc() of the process, see mm_preload.c*/
+static void
+mm_numa_init(){
 	
-	vm_page_family_t *vm_page_family_curr = NULL;
-	vm_page_for_families_t *new_vm_page_for_families = NULL;
+	char buffer[256];
+	char *curr, *end;
+	unsigned long first, last, node;
+	ssize_t length;
+	int fd = open(MM_NUMA_ONLINE_NODES, O_RDONLY);
 	
-	if(struct_size > SYSTEM_PAGE_SIZE) {
-		printf("Error : %s() Structure %s Size exceeds system page size\n",
-			__FUNCTION__, struct_name);
-		return;
-	}
+	numa_online_nodes = 0;
+	numa_n_nodes = 0;
 	
-	if(!first_vm_page_for_families){
+	if(fd < 0)
+		return;
 	
-		first_vm_page_for_families = 
-				(vm_page_for_families_t *)mm_get_new_vm_page_from_kernel(1);
-		first_vm_page_for_families->next = NULL;
-		strncpy(first_vm_page_for_families->vm_page_family[0].struct_name,
-		struct_name, MM_MAX_STRUCT_NAME);
-		first_vm_page_for_families->vm_page_family[0].struct_size = struct_size;
-		init_glthread(&first_vm_page_for_families->vm_page_family[0].free_block_priority_list_head);
+	length = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if(length <= 0)
 		return;
-	}
+	buffer[length] = '\0';
 	
-	uint32_t count = 0;
+	for(curr = buffer; ; curr = end + 1){
+		first = last = strtoul(curr, &end, 10);
+		if(end == curr)
+			break;
+		if(*end == '-'){
+			curr = end + 1;
+			last = strtoul(curr, &end, 10);
+			if(end == curr)
+				break;
+		}
+		for(node = first; node <= last && node < MM_NUMA_MAX_NODES; node++){
+			numa_online_nodes |= 1u << node;
+			numa_n_nodes++;
+		}
+		if(*end != ',')
+			break;
+	}
+}
+
+/*Node of the CPU the calling thread runs on, -1 when unknown. Threads
+  may migrate right after, the answer is a hint*/
+static inline int
+mm_numa_current_node(){
 	
-	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
-				
-		if(strcmp(vm_page_family_curr->struct_name, struct_name) !=0){
-			count++;
-			continue;
-		}	
-		
-		assert(0);	
-		
-	} ITERATE_PAGE_FAMILIES_END(first_vm_for_families, vm_page_family_curr);
+	unsigned int cpu, node;
 	
-	if(count == MAX_FAMILIES_PER_VM_PAGE){
-		
-		new_vm_page_for_families = 
-			(vm_page_for_families_t *)mm_get_new_vm_page_from_kernel(1);
-		new_vm_page_for_families->next = first_vm_page_for_families;
-		first_vm_page_for_families = new_vm_page_for_families;
-		vm_page_family_curr = &first_vm_page_for_families->vm_page_family[0];
-	}
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 29)
+	/*vDSO, no system call*/
+	if(getcpu(&cpu, &node))
+		return -1;
+#else
+	if(syscall(SYS_getcpu, &cpu, &node, NULL))
+		return -1;
+#endif
+	return (int)node;
+}
+
+/*Prefer node for the pages of a new mapping, before they are first
+  touched. The kernel falls back to other nodes once node is out of
+  memory. A failure is ignored, pages are then placed on first touch,
+  mostly by threads of the node anyway*/
+static void
+mm_numa_bind(void *address, size_t length, int node){
 	
-	strncpy(vm_page_family_curr->struct_name, struct_name, MM_MAX_STRUCT_NAME);
-	vm_page_family_curr->struct_size = struct_size;
-	vm_page_family_curr->first_page = NULL;
-	init_glthread(&first_vm_page_for_families->vm_page_family[0].free_block_priority_list_head);
+	unsigned long nodemask = 1ul << node;
 	
+	syscall(SYS_mbind, address, length, MM_MPOL_PREFERRED, &nodemask,
+			sizeof(nodemask) * 8 + 1, 0);
 }
 
+/*Families of the other nodes of a MM_FAMILY_NUMA_LOCAL family, the
+  registered family is bound to the first node*/
+static inline vm_bool_t
+mm_is_node_family(vm_page_family_t *vm_page_family){
+	
+	return vm_page_family->numa_node >= 0 &&
+		vm_page_family->numa_node != __builtin_ctz(numa_online_nodes) ?
+			MM_TRUE : MM_FALSE;
+}
 
-static void mm_union_free_blocks(block_meta_data_t *first, block_meta_data_t *second)
-{
-	assert(first->is_free == MM_TRUE && second->is_free == MM_TRUE);
+/*Page map, see MM_PAGEMAP_LEAF_BITS. Leaves are mapped on first use and
+  never released, the kernel zero fills them lazily*/
+static vm_page_t **
+mm_pagemap_get_leaf(uintptr_t page_number, vm_bool_t create){
 	
-	first->block_size += sizeof(block_meta_data_t) + second->block_size;
+	uintptr_t root_index = page_number >> MM_PAGEMAP_LEAF_BITS;
+	vm_page_t **leaf;
+	
+	if(root_index >= MM_PAGEMAP_ROOT_SIZE)
+		return NULL;
+	
+	leaf = __atomic_load_n(&mm_pagemap_root[root_index], __ATOMIC_ACQUIRE);
 	
-	first->next_block = second->next_block;
+	if(leaf || !create)
+		return leaf;
 	
-	if(second->next_block)
-		second->next_block->prev_block = first;
+	MM_LOCK(&mm_pagemap_lock);
+	leaf = mm_pagemap_root[root_index];
+	if(!leaf){
+		leaf = mmap(0, sizeof(vm_page_t *) << MM_PAGEMAP_LEAF_BITS,
+					PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, 0, 0);
+		if(leaf == MAP_FAILED){
+			printf("Error : Page map allocation Failed\n");
+			leaf = NULL;
+		}
+		else{
+			__atomic_store_n(&mm_pagemap_root[root_index], leaf, __ATOMIC_RELEASE);
+		}
+	}
+	MM_UNLOCK(&mm_pagemap_lock);
+	return leaf;
 }
 
-
-void mm_print_registered_page_families(){
-
-	vm_page_family_t *vm_page_family_curr = NULL;
+/*Map every system page of the VM data page to it, or unmap with NULL*/
+static vm_bool_t
+mm_pagemap_set(vm_page_t *vm_page, uint32_t units, vm_page_t *value){
 	
-	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
-				
-		
-		printf("Page Family : %s ,Size = %d \n",vm_page_family_curr->struct_name,	\
-				vm_page_family_curr->struct_size);
-			
-		
-	} ITERATE_PAGE_FAMILIES_END(first_vm_for_families, vm_page_family_curr);
+	uintptr_t page_number = (uintptr_t)vm_page >> SYSTEM_PAGE_SHIFT;
+	uintptr_t mask = (1ul << MM_PAGEMAP_LEAF_BITS) - 1;
+	vm_page_t **leaf = NULL;
+	uint32_t i;
 	
+	for(i = 0; i < units; i++, page_number++){
+		if(!leaf || !(page_number & mask)){
+			leaf = mm_pagemap_get_leaf(page_number, value ? MM_TRUE : MM_FALSE);
+			if(!leaf)
+				return MM_FALSE;
+		}
+		leaf[page_number & mask] = value;
+	}
+	return MM_TRUE;
 }
 
-vm_page_family_t * lookup_page_family_by_name (char *struct_name)
-{
-	vm_page_family_t *vm_page_family_curr = NULL;
+static inline vm_page_t *
+mm_pagemap_lookup(void *address){
 	
-	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr)
-	{
-			
-		if(strcmp(vm_page_family_curr->struct_name, struct_name) == 0)
-		{
-			return vm_page_family_curr;
-		}
-		
-	} ITERATE_PAGE_FAMILIES_END(first_vm_for_families, vm_page_family_curr);
+	uintptr_t page_number = (uintptr_t)address >> SYSTEM_PAGE_SHIFT;
+	vm_page_t **leaf = mm_pagemap_get_leaf(page_number, MM_FALSE);
 	
-	return NULL;
+	if(!leaf)
+		return NULL;
+	
+	return leaf[page_number & ((1ul << MM_PAGEMAP_LEAF_BITS) - 1)];
 }
 
+/*Chunks*/
 
-vm_bool_t mm_is_vm_page_empty(vm_page_t *vm_page){
-	if(vm_page->block_meta_data.next_block == NULL && 
-		vm_page->block_meta_data.prev_block == NULL &&
-		vm_page->block_meta_data.is_free == MM_TRUE){
-			
-			return MM_TRUE;
-		}
-	return MM_FALSE;
-} 
-
-
-static inline uint32_t mm_max_page_allocatable_memory(int units){
-	return (uint32_t) ((SYSTEM_PAGE_SIZE * units) - offset_of(vm_page_t, page_memory));
-				
+static void
+mm_chunk_mark(mm_chunk_t *chunk, uint32_t first, uint32_t units, vm_bool_t used){
+	
+	uint32_t i;
+	
+	for(i = first; i < first + units; i++){
+		if(used)
+			chunk->bitmap[i >> 6] |= 1ull << (i & 63);
+		else
+			chunk->bitmap[i >> 6] &= ~(1ull << (i & 63));
+	}
 }
 
-
-
-/*Return a fresh new virtual page*/
-vm_page_t *
-allocate_vm_page(vm_page_family_t *vm_page_family, int units){
+/*First run of units released pages below carved_units, UINT32_MAX if
+  there is none*/
+static uint32_t
+mm_chunk_find_free_run(mm_chunk_t *chunk, uint32_t units){
 	
-	vm_page_t *vm_page = mm_get_new_vm_page_from_kernel(1);
+	uint32_t i = chunk->header_units, run = 0;
+	uint64_t word;
 	
-	/*Initialize lower most Meta block of the VM page*/
-	MARK_VM_PAGE_EMPTY(vm_page);
+	while(i < chunk->carved_units){
+		word = chunk->bitmap[i >> 6];
+		if(!(i & 63) && word == ~0ull){
+			run = 0;
+			i += 64;
+			continue;
+		}
+		if(word & (1ull << (i & 63)))
+			run = 0;
+		else if(++run == units)
+			return i + 1 - units;
+		i++;
+	}
+	return UINT32_MAX;
+}
+
+/*Sets *zeroed when the pages read as zero. Caller holds mm_chunk_lock*/
+static void *
+mm_chunk_carve(mm_chunk_t *chunk, uint32_t units, vm_bool_t *zeroed){
 	
-	vm_page->block_meta_data.block_size = mm_max_page_allocatable_memory(1);
+	uint32_t first = UINT32_MAX;
+	uint32_t released_units = chunk->carved_units - chunk->header_units -
+								chunk->used_units;
 	
-	vm_page->block_meta_data.offset = offset_of(vm_page_t, block_meta_data);
-	init_glthread(&vm_page->block_meta_data.priority_thread_glue);
-	vm_page->next = NULL;
-	vm_page->prev = NULL;
+	if(released_units >= units)
+		first = mm_chunk_find_free_run(chunk, units);
 	
-	/*Set the back pointer to page family*/
-	vm_page->page_family = vm_page_family;
+	*zeroed = chunk->released_dirty ? MM_FALSE : MM_TRUE;
 	
-	/*If it is a first VM data page for a given page family*/
-	if(!vm_page_family->first_page){
-		vm_page_family->first_page = vm_page;
-		return vm_page;
+	if(first == UINT32_MAX){
+		if(chunk->units - chunk->carved_units < units)
+			return NULL;
+		first = chunk->carved_units;
+		chunk->carved_units += units;
+		*zeroed = MM_TRUE;
 	}
 	
-	/* Insert new VM page to the head of the linked list*/
-	vm_page->next = vm_page_family->first_page;
-	vm_page_family->first_page = vm_page;
-	vm_page_family->first_page->prev = vm_page;
+	mm_chunk_mark(chunk, first, units, MM_TRUE);
+	chunk->used_units += units;
+	return (char *)chunk + ((size_t)first << SYSTEM_PAGE_SHIFT);
 }
 
-void mm_vm_page_delete_and_free(vm_page_t *vm_page){
-	vm_page_family_t *vm_page_family = vm_page->page_family;
-	
-	/*If the page being deleted is the head of the linked list*/
-	if(vm_page_family->first_page == vm_page)
-	{
-		vm_page_family->first_page = vm_page->next;
-		if(vm_page->next)
-			vm_page->next->prev = NULL;
-		vm_page->next = NULL;
-		vm_page->prev = NULL;
-		mm_return_vm_page_to_kernel((void *)vm_page, 1);
-		return;
-	}
+/*Page family growing into the chunks of owner, NULL for internal chunks*/
+static inline vm_page_family_t *
+mm_chunk_owner_family(mm_chunk_t **owner){
 	
-	/*If we are deleting the page from milddle or end of linked list*/
-	if(vm_page->next)
-		vm_page->next->prev = vm_page->prev;
-	vm_page->prev->next = vm_page->next;
-	mm_return_vm_page_to_kernel((void *)vm_page, 1);
+	if(owner == &internal_chunks)
+		return NULL;
+	return (vm_page_family_t *)((char *)owner -
+				offset_of(vm_page_family_t, chunks));
 }
 
-
-static int
-free_blocks_comparision_function(
-		void *_block_meta_data1,
-		void *_block_meta_data2){
+/*Map length bytes aligned to MM_HUGE_PAGE_SIZE, so that transparent huge
+  pages can back every aligned 2 MB of a chunk*/
+static void *
+mm_map_huge_page_aligned(size_t length){
 	
-	block_meta_data_t *block_meta_data1 = (block_meta_data_t *) block_meta_data1;
-	block_meta_data_t *block_meta_data2 = (block_meta_data_t *) block_meta_data2;
+	char *mapping, *aligned;
+	size_t slack = MM_HUGE_PAGE_SIZE - SYSTEM_PAGE_SIZE;
 	
-	if(block_meta_data1->block_size > block_meta_data2->block_size) 
-		return -1;
-	else if(block_meta_data1->block_size < block_meta_data2->block_size)
-		return 1;
-	return 0;
-}									
-
-static void
-mm_add_free_block_meta_data_to_free_block_list(
-					vm_page_family_t *vm_page_family,
-					block_meta_data_t *free_block){
-					
-	assert(free_block->is_free == MM_TRUE);
+	mapping = mmap(0, length + slack, PROT_READ|PROT_WRITE,
+				MAP_ANON|MAP_PRIVATE, 0, 0);
 	
-	glthread_priority_insert(&vm_page_family->free_block_priority_list_head,
-				&free_block->priority_thread_glue,
-				free_blocks_comparision_function,
-				offset_of(block_meta_data_t, priority_thread_glue));
-
+	if(mapping == MAP_FAILED)
+		return NULL;
+	
+	aligned = (char *)(((uintptr_t)mapping + MM_HUGE_PAGE_SIZE - 1) &
+						~(uintptr_t)(MM_HUGE_PAGE_SIZE - 1));
+	if(aligned != mapping)
+		munmap(mapping, aligned - mapping);
+	if(aligned + length != mapping + length + slack)
+		munmap(aligned + length, mapping + slack - aligned);
+	return aligned;
 }
 
-
-static vm_page_t * 
-mm_family_new_page_add(vm_page_family_t *vm_page_family, int units){
+/*Map a new chunk at the head of the owner list, backed by huge pages
+  as asked, see mm_huge_pages_t. Caller holds mm_chunk_lock*/
+static mm_chunk_t *
+mm_chunk_new(mm_chunk_t **owner, uint32_t units, uint32_t huge_pages){
 	
-	vm_page_t *vm_page = allocate_vm_page(vm_page_family, units);
+	size_t header_size = offset_of(mm_chunk_t, bitmap) +
+						 ((units + 63) / 64) * sizeof(uint64_t);
+	size_t length = (size_t)units << SYSTEM_PAGE_SHIFT;
+	mm_chunk_t *chunk = NULL;
+	vm_page_family_t *owner_family;
+	vm_bool_t hugetlb = MM_FALSE;
 	
-	if(!vm_page)
-		return NULL;
+#ifdef MAP_HUGETLB
+	/*Fails unless the hugetlbfs pool can reserve the whole chunk*/
+	if(huge_pages == MM_HUGE_PAGES_HUGETLB){
+		chunk = mmap(0, length, PROT_READ|PROT_WRITE,
+				MAP_ANON|MAP_PRIVATE|MAP_HUGETLB, 0, 0);
+		if(chunk == MAP_FAILED)
+			chunk = NULL;
+		else
+			hugetlb = MM_TRUE;
+	}
+#endif
 	
-	/* The new page is like one free block, add it to 
-	    free block list*/
-	mm_add_free_block_meta_data_to_free_block_list(
-		vm_page_family, &vm_page->block_meta_data);
-		
-	return vm_page;
+	/*Never touched pages of the mapping cost no memory*/
+	if(!chunk){
+		chunk = mm_map_huge_page_aligned(length);
+		if(!chunk)
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		if(huge_pages != MM_HUGE_PAGES_OFF)
+			madvise(chunk, length, MADV_HUGEPAGE);
+#endif
+	}
+	
+	owner_family = mm_chunk_owner_family(owner);
+	if(owner_family){
+		if(owner_family->numa_node >= 0)
+			mm_numa_bind(chunk, length, owner_family->numa_node);
+		__atomic_fetch_add(&owner_family->n_mmap_calls, 1, __ATOMIC_RELAXED);
+	}
+	
+	chunk->owner = owner;
+	chunk->units = units;
+	chunk->header_units = (header_size + SYSTEM_PAGE_SIZE - 1) >> SYSTEM_PAGE_SHIFT;
+	chunk->carved_units = chunk->header_units;
+	chunk->used_units = 0;
+	chunk->hugetlb = hugetlb;
+	chunk->released_dirty = MM_FALSE;
+	mm_chunk_mark(chunk, 0, chunk->header_units, MM_TRUE);
+	
+	chunk->next = *owner;
+	*owner = chunk;
+	n_chunks++;
+	chunk_reserved_units += units;
+	return chunk;
 }
 
-
-static vm_bool_t
-mm_split_free_data_block_for_allocation(
-					vm_page_family_t *vm_page_family,
-					block_meta_data_t *block_meta_data,
-					uint32_t size){
+static void
+mm_chunk_unmap(mm_chunk_t *chunk){
 	
-	block_meta_data_t *next_block_meta_data = NULL;
+	mm_chunk_t **link;
 	
-	assert(block_meta_data->is_free == MM_TRUE);
+	for(link = chunk->owner; *link != chunk; link = &(*link)->next);
+	*link = chunk->next;
+	n_chunks--;
+	chunk_reserved_units -= chunk->units;
 	
-	if(block_meta_data->block_size < size){
-		return MM_FALSE;
+	if(mm_chunk_owner_family(chunk->owner))
+		__atomic_fetch_add(&mm_chunk_owner_family(chunk->owner)->n_munmap_calls,
+				1, __ATOMIC_RELAXED);
+	
+	if(munmap(chunk, (size_t)chunk->units << SYSTEM_PAGE_SHIFT)){
+		printf("Error : %s() Could not munmap chunk\n", __FUNCTION__);
 	}
+}
+
+/*Carve units contiguous system pages from the chunks of the owner
+  list, mapping a new chunk of *next_chunk_units pages, then doubled,
+  when none has room*/
+static void *
+mm_chunk_get_pages(mm_chunk_t **owner, uint32_t *next_chunk_units,
+				   uint32_t huge_pages, uint32_t units,
+				   mm_chunk_t **chunk_out, vm_bool_t *zeroed){
 	
-	uint32_t remaining_size = 
-				block_meta_data->block_size - size;
+	mm_chunk_t *chunk;
+	void *address = NULL;
+	uint32_t min_units = MM_CHUNK_MIN_SIZE >> SYSTEM_PAGE_SHIFT;
+	uint32_t max_units = MM_CHUNK_MAX_SIZE >> SYSTEM_PAGE_SHIFT;
+	uint32_t chunk_units;
 	
-	block_meta_data->is_free = MM_FALSE;
-	block_meta_data->block_size = size;
-	remove_glthread(&block_meta_data->priority_thread_glue);
-	/*block_meta_data->offset remains unchanged*/
+	MM_LOCK(&mm_chunk_lock);
 	
-	/*Case 1: No split*/
-	if(!remaining_size){
-		return MM_TRUE;	
+	for(chunk = *owner; chunk; chunk = chunk->next){
+		address = mm_chunk_carve(chunk, units, zeroed);
+		if(address)
+			goto done;
 	}
 	
-	/*Case 3: Partial Split : Soft Internal Fragmentation*/
-	else if(sizeof(block_meta_data_t) < remaining_size &&
-				remaining_size < (sizeof(block_meta_data_t) + vm_page_family->struct_size)){
-		/*New Meta block is to be created*/
-		next_block_meta_data = NEXT_META_BLOCK_BY_SIZE(block_meta_data);
-		next_block_meta_data->is_free = MM_TRUE;
-		next_block_meta_data->block_size = 
-				remaining_size - sizeof(block_meta_data_t);
-		next_block_meta_data->offset = block_meta_data->offset + 
-				sizeof(block_meta_data_t) + block_meta_data->block_size;
-				
-		/*Insert new free block into priority queue*/
-		init_glthread(&next_block_meta_data->priority_thread_glue);
-		mm_add_free_block_meta_data_to_free_block_list(
-					vm_page_family, next_block_meta_data);
-		
-		/*To fix up linkages*/
-		mm_bind_blocks_for_allocation(block_meta_data, next_block_meta_data);
-		
-	}
+	chunk_units = *next_chunk_units ? *next_chunk_units : min_units;
 	
-	/*Case 3: Partial Split : Hard Internal Fragmentation*/
-	else if(remaining_size < sizeof(block_meta_data_t)){
-		/*No need to do anything !!*/
+	/*Retry smaller when the kernel refuses a big reservation*/
+	while(!(chunk = mm_chunk_new(owner, chunk_units, huge_pages))){
+		if(chunk_units <= min_units){
+			printf("Error : %s() Chunk allocation Failed\n", __FUNCTION__);
+			goto done;
+		}
+		chunk_units >>= 1;
 	}
 	
-	/*Case 2: Full split : New Meta block is created*/
-	else{
-		/*New Meta block is to be created*/
-		next_block_meta_data = NEXT_META_BLOCK_BY_SIZE(block_meta_data);
-		next_block_meta_data->is_free = MM_TRUE;
-		next_block_meta_data->block_size = 
-				remaining_size - sizeof(block_meta_data_t);
-		next_block_meta_data->offset = block_meta_data->offset + 
-				sizeof(block_meta_data_t) + block_meta_data->block_size;
-				
-		/*Insert new free block into priority queue*/
-		init_glthread(&next_block_meta_data->priority_thread_glue);
-		mm_add_free_block_meta_data_to_free_block_list(
-					vm_page_family, next_block_meta_data);
-		
-		/*To fix up linkages*/
-		mm_bind_blocks_for_allocation(block_meta_data, next_block_meta_data);
-	}
+	*next_chunk_units = chunk_units < max_units ? chunk_units << 1 : max_units;
+	address = mm_chunk_carve(chunk, units, zeroed);
 	
-	return MM_TRUE;
-
+done:
+	*chunk_out = chunk;
+	MM_UNLOCK(&mm_chunk_lock);
+	return address;
 }
 
+/*Returns whether the pages read as zero afterwards*/
+static vm_bool_t
+mm_page_advise(void *address, uint32_t units, mm_page_release_mode_t mode){
+	
+	size_t length = (size_t)units << SYSTEM_PAGE_SHIFT;
+	
+#ifdef MADV_FREE
+	/*Pages the kernel did not reclaim keep their contents*/
+	if(mode == MM_PAGE_RELEASE_MADV_FREE && !madvise(address, length, MADV_FREE))
+		return MM_FALSE;
+#endif
+	/*MADV_FREE needs Linux 4.5*/
+	return madvise(address, length, MADV_DONTNEED) ? MM_FALSE : MM_TRUE;
+}
 
+/*Release pages carved from a chunk. The chunk is unmapped once empty,
+  unless it is the newest of its owner*/
+static void
+mm_chunk_put_pages(mm_chunk_t *chunk, void *address, uint32_t units,
+				   mm_page_release_mode_t mode){
+	
+	uint32_t first = ((char *)address - (char *)chunk) >> SYSTEM_PAGE_SHIFT;
+	vm_bool_t zeroed = MM_FALSE;
+	
+	/*Huge pages cannot be released piecewise*/
+	if(!chunk->hugetlb)
+		zeroed = mm_page_advise(address, units, mode);
+	
+	MM_LOCK(&mm_chunk_lock);
+	if(!zeroed)
+		chunk->released_dirty = MM_TRUE;
+	mm_chunk_mark(chunk, first, units, MM_FALSE);
+	chunk->used_units -= units;
+	if(!chunk->used_units && *chunk->owner != chunk)
+		mm_chunk_unmap(chunk);
+	MM_UNLOCK(&mm_chunk_lock);
+}
 
-
-
-static block_meta_data_t *
-mm_allocate_free_data_block(
-		vm_page_family_t *vm_page_family,
-		uint32_t req_size){
+/*Extend the pages carved at address from units to new_units pages when
+  the pages right after them are free. Returns whether it could*/
+static vm_bool_t
+mm_chunk_extend_pages(mm_chunk_t *chunk, void *address, uint32_t units,
+					  uint32_t new_units){
 	
-	vm_bool_t status = MM_FALSE;
-	vm_page_t *vm_page = NULL;
-	block_meta_data_t *block_meta_data = NULL;
+	uint32_t first = ((char *)address - (char *)chunk) >> SYSTEM_PAGE_SHIFT;
+	uint32_t i;
+	vm_bool_t extended = MM_FALSE;
 	
-	block_meta_data_t *biggest_block_meta_data = 
-		mm_get_biggest_free_block_page_family(vm_page_family);
+	MM_LOCK(&mm_chunk_lock);
 	
-	if(!biggest_block_meta_data ||
-			biggest_block_meta_data->block_size < req_size){
-		
-		/*Time to add a new ppage to page family to satisfy the request*/
-		vm_page = mm_family_new_page_add(vm_page_family, 1);
-		
-		/*Allocate the free block from this page now*/
-		status = mm_split_free_data_block_for_allocation(vm_page_family,
-							&vm_page->block_meta_data, req_size);
-				
-		if(status)
-			return &vm_page->block_meta_data;
-		
-		return NULL;
-	}
+	if(first + new_units > chunk->units)
+		goto done;
 	
-	/*The biggest block meta data can satisfy the request*/
-	if(biggest_block_meta_data){
-		status = mm_split_free_data_block_for_allocation(vm_page_family,
-				biggest_block_meta_data, req_size);
+	for(i = first + units; i < first + new_units && i < chunk->carved_units; i++){
+		if(chunk->bitmap[i >> 6] & (1ull << (i & 63)))
+			goto done;
 	}
 	
-	if(status)
-		return biggest_block_meta_data;
-	
-	return NULL;
+	if(first + new_units > chunk->carved_units)
+		chunk->carved_units = first + new_units;
+	mm_chunk_mark(chunk, first + units, new_units - units, MM_TRUE);
+	chunk->used_units += new_units - units;
+	extended = MM_TRUE;
 	
+done:
+	MM_UNLOCK(&mm_chunk_lock);
+	return extended;
 }
 
-
-/*Fn to mark block_meta_data as being Allocated for
-  'size' bytes of application data. Return TRUE if
-  block allocation succeeds						*/
-  
-
-/*The public function to be invoked by the application for Dynamic Memory Allocation*/
-void * 
-xcalloc(char *struct_name, int units){
-
-	/*Step 1*/
-	vm_page_family_t *pg_family = 
-			lookup_page_family_by_name(struct_name);
-	
-	if(!pg_family){
-		printf("Error : Structure %s is not registered with Memory Manager\n",
-																	struct_name);
-		return NULL;
-	}
+/*Bucket of the latency histograms counting ticks, see mm_latency_histogram_t*/
+static inline uint32_t
+mm_latency_bucket(uint64_t ticks){
 	
+	uint32_t msb;
 	
-	/*Find the page which can satisfy the request*/
-	block_meta_data_t *free_block_meta_data = NULL;
+	if(ticks < MM_LATENCY_SUB_BUCKETS)
+		return (uint32_t)ticks;
 	
-	free_block_meta_data = mm_allocate_free_data_block(
-					pg_family, units * pg_family->struct_size);
-					
-	if(free_block_meta_data){
-		memset((char *)(free_block_meta_data + 1), 0,
-			free_block_meta_data->block_size);
-		return (void *)(free_block_meta_data + 1);
-	}
+	msb = 63 - __builtin_clzll(ticks);
 	
-	return NULL;
+	if(msb > MM_LATENCY_MAX_LOG2)
+		return MM_LATENCY_BUCKETS - 1;
 	
+	return (msb - MM_LATENCY_SUB_BUCKET_BITS + 1) * MM_LATENCY_SUB_BUCKETS +
+		(uint32_t)((ticks >> (msb - MM_LATENCY_SUB_BUCKET_BITS)) ^
+					MM_LATENCY_SUB_BUCKETS);
 }
 
+#ifdef MM_LATENCY_STATS
+/*One in every mm_latency_period allocations and frees of a thread is
+  timed, 0 disables timing*/
+static uint32_t mm_latency_period = 1;
+#ifdef MM_THREAD_SAFE
+static __thread uint32_t mm_latency_countdown;
+#else
+static uint32_t mm_latency_countdown;
+#endif
 
-static int
-mm_get_hard_internal_memory_frag_size(
-			block_meta_data_t *first,
-			block_meta_data_t *second){
-
-	block_meta_data_t *next_block = NEXT_META_BLOCK_BY_SIZE(first);
-	return (int)((unsigned long)second - (unsigned long)(next_block));
+static inline uint64_t
+mm_latency_ticks(){
+	
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
 }
 
+/*Start of an operation, 0 when it is not to be timed. Sampled operations
+  count against the period of the calling thread*/
+static inline uint64_t
+mm_latency_start(vm_bool_t sampled){
+	
+	uint32_t period = __atomic_load_n(&mm_latency_period, __ATOMIC_RELAXED);
+	
+	if(!period)
+		return 0;
+	
+	if(sampled){
+		if(mm_latency_countdown > 1){
+			mm_latency_countdown--;
+			return 0;
+		}
+		mm_latency_countdown = period;
+	}
+	return mm_latency_ticks();
+}
+
+static void
+mm_latency_record(vm_page_family_t *vm_page_family, mm_latency_op_t op,
+				  uint64_t start){
+	
+	uint64_t ticks = mm_latency_ticks() - start;
+	mm_latency_histogram_t *histogram;
+	
+	if(!vm_page_family->latency_histograms)
+		return;
+	
+	/*The TSC of another core may lag a little behind*/
+	if((int64_t)ticks < 0)
+		ticks = 0;
+	
+	histogram = &vm_page_family->latency_histograms[op];
+	
+#ifdef MM_THREAD_SAFE
+	uint64_t max_ticks = __atomic_load_n(&histogram->max_ticks, __ATOMIC_RELAXED);
+	
+	__atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->total_ticks, ticks, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->buckets[mm_latency_bucket(ticks)], 1,
+			__ATOMIC_RELAXED);
+	while(ticks > max_ticks &&
+		!__atomic_compare_exchange_n(&histogram->max_ticks, &max_ticks, ticks,
+			MM_TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#else
+	histogram->count++;
+	histogram->total_ticks += ticks;
+	histogram->buckets[mm_latency_bucket(ticks)]++;
+	if(ticks > histogram->max_ticks)
+		histogram->max_ticks = ticks;
+#endif
+}
+
+/*Histograms of a new page family, from the pages of the memory manager*/
+static mm_latency_histogram_t *
+mm_latency_histograms_new(){
+	
+	size_t size = MM_LATENCY_OPS * sizeof(mm_latency_histogram_t);
+	uint32_t units = (size + SYSTEM_PAGE_SIZE - 1) >> SYSTEM_PAGE_SHIFT;
+	mm_chunk_t *chunk;
+	vm_bool_t zeroed;
+	mm_latency_histogram_t *histograms = mm_chunk_get_pages(&internal_chunks,
+			&internal_next_chunk_units, MM_HUGE_PAGES_OFF, units, &chunk, &zeroed);
+	
+	if(histograms && !zeroed)
+		memset(histograms, 0, size);
+	return histograms;
+}
+#endif /*MM_LATENCY_STATS*/
+
+/*FNV-1a hash over at most MM_MAX_STRUCT_NAME characters, the same
+  prefix strncpy() stores in vm_page_family_t->struct_name*/
+static uint32_t
+mm_page_family_name_hash(const char *struct_name){
+	
+	uint32_t hash = 2166136261u;
+	uint32_t i = 0;
+	
+	for( ; i < MM_MAX_STRUCT_NAME && struct_name[i]; i++){
+		hash ^= (unsigned char)struct_name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t
+mm_page_family_registry_pages(uint32_t size){
+	
+	return (uint32_t)((size * sizeof(vm_page_family_t *) + SYSTEM_PAGE_SIZE - 1) /
+						SYSTEM_PAGE_SIZE);
+}
+
+static void
+mm_page_family_registry_insert(vm_page_family_t **registry, uint32_t size,
+							   vm_page_family_t *vm_page_family){
+	
+	uint32_t mask = size - 1;
+	uint32_t slot = vm_page_family->name_hash & mask;
+	
+	while(registry[slot])
+		slot = (slot + 1) & mask;
+	
+	registry[slot] = vm_page_family;
+}
+
+/*Double the registry and rehash, the stored name_hash avoids rehashing
+  the names themselves*/
+static vm_bool_t
+mm_page_family_registry_grow(){
+	
+	uint32_t i;
+	uint32_t new_size = page_family_registry_size ?
+		page_family_registry_size * 2 :
+		(uint32_t)(SYSTEM_PAGE_SIZE / sizeof(vm_page_family_t *));
+	
+	vm_page_family_t **new_registry = mm_get_new_vm_page_from_kernel(
+						mm_page_family_registry_pages(new_size));
+	
+	if(!new_registry)
+		return MM_FALSE;
+	
+	for(i = 0; i < page_family_registry_size; i++){
+		if(page_family_registry[i])
+			mm_page_family_registry_insert(new_registry, new_size,
+									page_family_registry[i]);
+	}
+	
+	if(page_family_registry)
+		mm_return_vm_page_to_kernel(page_family_registry,
+			mm_page_family_registry_pages(page_family_registry_size));
+	
+	page_family_registry = new_registry;
+	page_family_registry_size = new_size;
+	return MM_TRUE;
+}
+
+static vm_page_family_t *
+mm_page_family_registry_lookup(char *struct_name, uint32_t name_hash){
+	
+	uint32_t mask, slot;
+	vm_page_family_t *vm_page_family_curr;
+	
+	if(!page_family_registry)
+		return NULL;
+	
+	mask = page_family_registry_size - 1;
+	slot = name_hash & mask;
+	
+	for( ; (vm_page_family_curr = page_family_registry[slot]);
+			slot = (slot + 1) & mask){
+		
+		if(vm_page_family_curr->name_hash == name_hash &&
+			strncmp(vm_page_family_curr->struct_name, struct_name,
+					MM_MAX_STRUCT_NAME) == 0){
+			return vm_page_family_curr;
+		}
+	}
+	return NULL;
+}
+
+static void
+mm_init_free_block_lists(vm_page_family_t *vm_page_family){
+	
+	uint32_t fl, sl;
+	
+	vm_page_family->free_block_fl_bitmap = 0;
+	
+	for(fl = 0; fl < MM_FREE_BLOCK_FL_COUNT; fl++){
+		vm_page_family->free_block_sl_bitmap[fl] = 0;
+		for(sl = 0; sl < MM_FREE_BLOCK_SL_COUNT; sl++)
+			init_glthread(&vm_page_family->free_block_lists[fl][sl]);
+	}
+}
+
+/*Data bytes of the lower most block, which spans the whole page*/
+static inline uint32_t mm_max_page_allocatable_memory(int units){
+	return (uint32_t) ((SYSTEM_PAGE_SIZE * units) -
+			offset_of(vm_page_t, block_meta_data) - sizeof(block_meta_data_t));
+				
+}
+
+/*Slot size of the objects of a slab family, whole cache lines for cache
+  aligned families since slots are aligned to their size*/
+static inline uint32_t
+mm_family_slot_size(uint32_t struct_size, uint32_t flags){
+	
+	if(flags & (MM_FAMILY_CACHE_ALIGNED | MM_FAMILY_CACHE_PADDED))
+		return MM_ALIGN_UP_TO(struct_size, MM_CACHE_LINE_SIZE);
+	return MM_ALIGN_UP(struct_size);
+}
+
+/*Data block size serving req_size bytes in the family. The blocks of
+  aligned families span whole alignment strides with their meta block,
+  so blocks carved back to back all start their data aligned*/
+static inline uint32_t
+mm_family_block_size(vm_page_family_t *vm_page_family, uint32_t req_size){
+	
+	uint32_t align = vm_page_family->object_align;
+	
+	if(vm_page_family->flags & MM_FAMILY_CACHE_PADDED)
+		req_size = MM_ALIGN_UP_TO(req_size, MM_CACHE_LINE_SIZE);
+	
+	if(align <= MM_ALIGNMENT)
+		return MM_BLOCK_SIZE(req_size);
+	
+	return MM_ALIGN_UP_TO(MM_BLOCK_SIZE(req_size) + sizeof(block_meta_data_t),
+				align) - sizeof(block_meta_data_t);
+}
+
+/*Number of object slots and offset of the first slot of a slab page
+  holding objects of slot_size bytes*/
+static uint32_t
+mm_slab_geometry(uint32_t slot_size, uint32_t units, uint32_t *first_slot_offset){
+	
+	uint32_t page_memory_offset = offset_of(vm_page_t, page_memory);
+	uint32_t span_size = units * SYSTEM_PAGE_SIZE;
+	uint32_t avail = span_size - page_memory_offset;
+	uint32_t slot_align = slot_size & -slot_size;
+	
+	/*Every slot costs slot_size bytes plus one bit of bitmap*/
+	uint32_t n_objects = (avail * 8) / (slot_size * 8 + 1);
+	
+	if(slot_align > MM_SLAB_MAX_SLOT_ALIGN)
+		slot_align = MM_SLAB_MAX_SLOT_ALIGN;
+	
+	while(n_objects){
+		*first_slot_offset = (page_memory_offset +
+							((n_objects + 63) / 64) * sizeof(uint64_t) +
+							slot_align - 1) & ~(slot_align - 1);
+		if(*first_slot_offset + n_objects * slot_size <= span_size)
+			break;
+		n_objects--;
+	}
+	return n_objects;
+}
+
+vm_page_family_t *
+mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size){
+	
+	return mm_instantiate_new_page_family_with_flags(struct_name, struct_size, 0);
+}
+
+/*Slot for a new page family, from the VM pages holding the families*/
+static inline vm_page_family_t *
+mm_page_family_slot_new(){
+	
+	vm_page_for_families_t *new_vm_page_for_families = NULL;
+	
+	if(!first_vm_page_for_families ||
+		families_in_first_vm_page_for_families == MAX_FAMILIES_PER_VM_PAGE){
+		
+		mm_chunk_t *chunk;
+		vm_bool_t zeroed;
+		
+		new_vm_page_for_families = (vm_page_for_families_t *)
+			mm_chunk_get_pages(&internal_chunks, &internal_next_chunk_units,
+								MM_HUGE_PAGES_OFF, 1, &chunk, &zeroed);
+		
+		if(!new_vm_page_for_families)
+			return NULL;
+		
+		new_vm_page_for_families->next = first_vm_page_for_families;
+		first_vm_page_for_families = new_vm_page_for_families;
+		families_in_first_vm_page_for_families = 0;
+	}
+	
+	return &first_vm_page_for_families->vm_page_family[
+							families_in_first_vm_page_for_families++];
+}
+
+static void
+mm_page_family_init(vm_page_family_t *vm_page_family_curr,
+					uint32_t struct_size, uint32_t flags, uint32_t name_hash,
+					uint32_t span_units, int32_t numa_node){
+	
+	vm_page_family_curr->struct_size = struct_size;
+	vm_page_family_curr->name_hash = name_hash;
+	vm_page_family_curr->flags = flags;
+	vm_page_family_curr->object_align =
+		(flags & (MM_FAMILY_CACHE_ALIGNED | MM_FAMILY_CACHE_PADDED)) ?
+			MM_CACHE_LINE_SIZE : MM_ALIGNMENT;
+	vm_page_family_curr->family_id = n_page_families++;
+	vm_page_family_curr->span_units = span_units;
+	vm_page_family_curr->large_threshold = UINT32_MAX;
+	vm_page_family_curr->numa_node = numa_node;
+	memset(vm_page_family_curr->node_families, 0,
+		sizeof(vm_page_family_curr->node_families));
+	MM_LOCK_INIT(&vm_page_family_curr->family_lock);
+	vm_page_family_curr->first_page = NULL;
+	vm_page_family_curr->empty_pages = NULL;
+	vm_page_family_curr->n_empty_pages = 0;
+	vm_page_family_curr->release_pages = NULL;
+	vm_page_family_curr->empty_pages_low = MM_FAMILY_PAGE_CACHE_LOW;
+	vm_page_family_curr->empty_pages_high = MM_FAMILY_PAGE_CACHE_HIGH;
+	vm_page_family_curr->chunks = NULL;
+	vm_page_family_curr->next_chunk_units = 0;
+	vm_page_family_curr->huge_pages = MM_HUGE_PAGES_OFF;
+	vm_page_family_curr->relocate = NULL;
+	vm_page_family_curr->relocate_arg = NULL;
+	init_glthread(&vm_page_family_curr->partial_slab_list_head);
+	mm_init_free_block_lists(vm_page_family_curr);
+#ifdef MM_LATENCY_STATS
+	vm_page_family_curr->latency_histograms = mm_latency_histograms_new();
+#endif
+}
+
+static vm_page_family_t *
+mm_page_family_registry_add(char *struct_name,
+						uint32_t struct_size, uint32_t flags){
+	
+	vm_page_family_t *vm_page_family_curr = NULL;
+	vm_page_family_t *node_family;
+	uint32_t name_hash = mm_page_family_name_hash(struct_name);
+	uint32_t first_slot_offset;
+	uint32_t span_units = default_span_units;
+	int32_t numa_node = -1;
+	uint32_t node;
+	
+	/*Grow the span of big structures so it holds a few of them, bigger
+	  ones end up in dedicated regions*/
+	while(span_units < MM_MAX_SPAN_UNITS &&
+			mm_max_page_allocatable_memory(span_units) <
+			MM_MIN_OBJECTS_PER_SPAN * (mm_family_slot_size(struct_size, flags) +
+				sizeof(block_meta_data_t))){
+		span_units *= 2;
+	}
+	
+	if((flags & MM_FAMILY_SLAB) &&
+		mm_slab_geometry(mm_family_slot_size(struct_size, flags), span_units,
+				&first_slot_offset) < 2) {
+		printf("Error : %s() Structure %s is too big for slab pages\n",
+			__FUNCTION__, struct_name);
+		return NULL;
+	}
+	
+	/*Duplicate registration*/
+	assert(!mm_page_family_registry_lookup(struct_name, name_hash));
+	
+	if((page_family_registry_count + 1) * 2 > page_family_registry_size &&
+		!mm_page_family_registry_grow()){
+		return NULL;
+	}
+	
+	vm_page_family_curr = mm_page_family_slot_new();
+	if(!vm_page_family_curr)
+		return NULL;
+	
+	if((flags & MM_FAMILY_NUMA_LOCAL) && numa_n_nodes > 1)
+		numa_node = __builtin_ctz(numa_online_nodes);
+	
+	strncpy(vm_page_family_curr->struct_name, struct_name, MM_MAX_STRUCT_NAME);
+	mm_page_family_init(vm_page_family_curr, struct_size, flags, name_hash,
+		span_units, numa_node);
+	
+	/*Threads of a node left without a family of its own allocate from
+	  the first node*/
+	for(node = numa_node + 1; numa_node >= 0 && node < MM_NUMA_MAX_NODES; node++){
+		
+		if(!(numa_online_nodes & (1u << node)))
+			continue;
+		
+		node_family = mm_page_family_slot_new();
+		if(!node_family)
+			break;
+		
+		memcpy(node_family->struct_name, vm_page_family_curr->struct_name,
+			MM_MAX_STRUCT_NAME);
+		mm_page_family_init(node_family, struct_size, flags, name_hash,
+			span_units, node);
+		vm_page_family_curr->node_families[node] = node_family;
+	}
+	
+	mm_page_family_registry_insert(page_family_registry,
+		page_family_registry_size, vm_page_family_curr);
+	page_family_registry_count++;
+	
+	return vm_page_family_curr;
+}
+
+vm_page_family_t *
+mm_instantiate_new_page_family_with_flags(char *struct_name,
+						uint32_t struct_size, uint32_t flags){
+	
+	vm_page_family_t *vm_page_family;
+	
+	MM_REGISTRY_WRLOCK();
+	vm_page_family = mm_page_family_registry_add(struct_name, struct_size, flags);
+	MM_REGISTRY_UNLOCK();
+	
+	return vm_page_family;
+}
+
+static uint32_t
+mm_span_size_to_units(uint32_t span_size){
+	
+	uint32_t units = (uint32_t)((span_size + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+	
+	if(units < 1)
+		units = 1;
+	if(units > MM_MAX_SPAN_UNITS)
+		units = MM_MAX_SPAN_UNITS;
+	return units;
+}
+
+void
+mm_set_default_span_size(uint32_t span_size){
+	
+	MM_REGISTRY_WRLOCK();
+	default_span_units = mm_span_size_to_units(span_size);
+	MM_REGISTRY_UNLOCK();
+}
+
+void
+mm_family_set_span_size(vm_page_family_t *vm_page_family, uint32_t span_size){
+	
+	uint32_t span_units = mm_span_size_to_units(span_size);
+	uint32_t first_slot_offset;
+	vm_page_family_t *node_family;
+	
+	/*Slab pages must keep room for at least two objects*/
+	if((vm_page_family->flags & MM_FAMILY_SLAB) &&
+		mm_slab_geometry(mm_family_slot_size(vm_page_family->struct_size,
+				vm_page_family->flags), span_units, &first_slot_offset) < 2){
+		printf("Error : %s() Span of %u bytes is too small for slab family %s\n",
+			__FUNCTION__, span_size, vm_page_family->struct_name);
+		return;
+	}
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	vm_page_family->span_units = span_units;
+	MM_UNLOCK(&vm_page_family->family_lock);
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_family_set_span_size(node_family, span_size);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+}
+
+void
+mm_family_set_huge_pages(vm_page_family_t *vm_page_family,
+						 mm_huge_pages_t huge_pages){
+	
+	vm_page_family_t *node_family;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	vm_page_family->huge_pages = huge_pages;
+	MM_UNLOCK(&vm_page_family->family_lock);
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_family_set_huge_pages(node_family, huge_pages);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+}
+
+void
+mm_family_set_large_threshold(vm_page_family_t *vm_page_family,
+							  uint32_t large_threshold){
+	
+	vm_page_family_t *node_family;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	vm_page_family->large_threshold = large_threshold;
+	MM_UNLOCK(&vm_page_family->family_lock);
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_family_set_large_threshold(node_family, large_threshold);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+}
+
+void
+mm_family_set_relocation_callback(vm_page_family_t *vm_page_family,
+								  mm_relocate_fn_t relocate, void *arg){
+	
+	vm_page_family_t *node_family;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	vm_page_family->relocate = relocate;
+	vm_page_family->relocate_arg = arg;
+	MM_UNLOCK(&vm_page_family->family_lock);
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_family_set_relocation_callback(node_family, relocate, arg);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+}
+
+
+block_meta_data_t *
+mm_next_meta_block(block_meta_data_t *block_meta_data){
+	
+	vm_page_t *vm_page = MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+	uint32_t next_offset = block_meta_data->offset +
+				sizeof(block_meta_data_t) + block_meta_data->block_size;
+	
+	if(next_offset >= (vm_page->page_units << SYSTEM_PAGE_SHIFT))
+		return NULL;
+	
+	return (block_meta_data_t *)((char *)vm_page + next_offset);
+}
+
+static void mm_union_free_blocks(block_meta_data_t *first, block_meta_data_t *second)
+{
+	block_meta_data_t *next_block;
+	
+	assert(first->is_free == MM_TRUE && second->is_free == MM_TRUE);
+	
+	first->block_size += sizeof(block_meta_data_t) + second->block_size;
+	
+	next_block = NEXT_META_BLOCK(first);
+	if(next_block)
+		next_block->prev_offset = first->offset;
+}
+
+
+void mm_print_registered_page_families(){
+
+	static const char *placements[] = {"", "(best fit)", "(first fit)",
+									   "(densest page)"};
+	vm_page_family_t *vm_page_family_curr = NULL;
+	
+	MM_REGISTRY_RDLOCK();
+	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
+				
+		
+		if(mm_is_node_family(vm_page_family_curr))
+			continue;
+		
+		printf("Page Family : %s ,Size = %d %s%s%s%s\n",vm_page_family_curr->struct_name,	\
+				vm_page_family_curr->struct_size,
+				vm_page_family_curr->flags & MM_FAMILY_SLAB ? "(slab)" : "",
+				vm_page_family_curr->flags & MM_FAMILY_CACHE_PADDED ? "(cache padded)" :
+				vm_page_family_curr->flags & MM_FAMILY_CACHE_ALIGNED ? "(cache aligned)" : "",
+				vm_page_family_curr->numa_node >= 0 ? "(numa local)" : "",
+				placements[(vm_page_family_curr->flags & MM_FAMILY_PLACEMENT_MASK) /
+					MM_FAMILY_BEST_FIT]);
+			
+		
+	} ITERATE_PAGE_FAMILIES_END(first_vm_for_families, vm_page_family_curr);
+	MM_REGISTRY_UNLOCK();
+	
+}
+
+vm_page_family_t * lookup_page_family_by_name (char *struct_name)
+{
+	vm_page_family_t *vm_page_family;
+	
+	MM_REGISTRY_RDLOCK();
+	vm_page_family = mm_page_family_registry_lookup(struct_name,
+				mm_page_family_name_hash(struct_name));
+	MM_REGISTRY_UNLOCK();
+	
+	return vm_page_family;
+}
+
+
+vm_bool_t mm_is_vm_page_empty(vm_page_t *vm_page){
+	if(vm_page->page_type == MM_VM_PAGE_SLAB)
+		return vm_page->slab_meta_data.n_free == vm_page->slab_meta_data.n_objects ?
+				MM_TRUE : MM_FALSE;
+	
+	if(vm_page->block_meta_data.is_free == MM_TRUE &&
+		vm_page->block_meta_data.block_size ==
+			mm_max_page_allocatable_memory(vm_page->page_units)){
+			
+			return MM_TRUE;
+		}
+	return MM_FALSE;
+} 
+
+
+
+
+
+/*Empty page cache*/
+
+/*Unlink and return the first page of units system pages in the list*/
+static vm_page_t *
+mm_page_list_take(vm_page_t **head, uint32_t units){
+	
+	vm_page_t **link;
+	vm_page_t *vm_page;
+	
+	for(link = head; (vm_page = *link); link = &vm_page->next){
+		if(vm_page->page_units == units){
+			*link = vm_page->next;
+			return vm_page;
+		}
+	}
+	return NULL;
+}
+
+/*Cut the list after its first keep pages, return the rest*/
+static vm_page_t *
+mm_page_list_cut(vm_page_t **head, uint32_t keep){
+	
+	vm_page_t **link = head;
+	vm_page_t *rest;
+	
+	while(keep-- && *link)
+		link = &(*link)->next;
+	
+	rest = *link;
+	*link = NULL;
+	return rest;
+}
+
+/*Give the memory of a VM data page back, to its chunk or to the kernel*/
+static void
+mm_vm_page_release(vm_page_t *vm_page, mm_page_release_mode_t mode){
+	
+	/*The page header does not survive the release*/
+	vm_page_family_t *vm_page_family = vm_page->page_family;
+	MM_LATENCY_START_ALWAYS(start);
+	
+	if(vm_page->chunk){
+		mm_chunk_put_pages(vm_page->chunk, vm_page, vm_page->page_units, mode);
+		MM_LATENCY_END(vm_page_family, MM_LATENCY_PAGE_RELEASE, start);
+		return;
+	}
+	
+	__atomic_fetch_add(&vm_page_family->n_munmap_calls, 1, __ATOMIC_RELAXED);
+	mm_return_vm_page_to_kernel((void *)vm_page, vm_page->page_units);
+	MM_LATENCY_END(vm_page_family, MM_LATENCY_PAGE_RELEASE, start);
+}
+
+/*Release a batch of pages dropped by the caches, call without locks*/
+static void
+mm_page_cache_release(vm_page_t *batch, mm_page_release_mode_t mode){
+	
+	vm_page_t *vm_page;
+	
+	while((vm_page = batch)){
+		batch = vm_page->next;
+		mm_vm_page_release(vm_page, mode);
+	}
+}
+
+/*Trim the global cache past its high watermark, returns the pages to
+  release. Caller holds global_page_cache_lock*/
+static vm_page_t *
+mm_global_page_cache_trim(){
+	
+	vm_page_t *batch;
+	
+	if(n_global_empty_pages <= global_empty_pages_high)
+		return NULL;
+	
+	batch = mm_page_list_cut(&global_empty_pages, global_empty_pages_low);
+	n_global_empty_pages = global_empty_pages_low;
+	return batch;
+}
+
+/*Hand the pages of the family cache past its low watermark over to the
+  global cache once it exceeds its high watermark. Returns the pages to
+  release after the family lock is let go: the global cache excess, or
+  the whole excess of a family bound to a NUMA node. Caller holds the
+  family lock*/
+static vm_page_t *
+mm_family_page_cache_trim(vm_page_family_t *vm_page_family){
+	
+	vm_page_t *batch, *last;
+	uint32_t count;
+	
+	if(vm_page_family->n_empty_pages <= vm_page_family->empty_pages_high)
+		return NULL;
+	
+	/*The most recently emptied pages are kept, they are still warm*/
+	batch = mm_page_list_cut(&vm_page_family->empty_pages,
+				vm_page_family->empty_pages_low);
+	count = vm_page_family->n_empty_pages - vm_page_family->empty_pages_low;
+	vm_page_family->n_empty_pages = vm_page_family->empty_pages_low;
+	
+	for(last = batch; ; last = last->next){
+		vm_page_family->n_cached_vm_pages -= last->page_units;
+		if(!last->next)
+			break;
+	}
+	
+	/*Pages of a node bound family are mbind'd to its node, shared they
+	  would hand remote memory to other families*/
+	if(vm_page_family->numa_node >= 0)
+		return batch;
+	
+	MM_LOCK(&global_page_cache_lock);
+	last->next = global_empty_pages;
+	global_empty_pages = batch;
+	n_global_empty_pages += count;
+	batch = mm_global_page_cache_trim();
+	MM_UNLOCK(&global_page_cache_lock);
+	return batch;
+}
+
+/*Retain an empty page unlinked from its family. Returns the pages to
+  release after the family lock is let go, large regions are never
+  retained. Caller holds the family lock*/
+static vm_page_t *
+mm_page_cache_put(vm_page_t *vm_page){
+	
+	vm_page_family_t *vm_page_family = vm_page->page_family;
+	
+	vm_page->prev = NULL;
+	
+	if(vm_page->page_type == MM_VM_PAGE_LARGE){
+		vm_page->next = NULL;
+		return vm_page;
+	}
+	
+	vm_page->next = vm_page_family->empty_pages;
+	vm_page_family->empty_pages = vm_page;
+	vm_page_family->n_empty_pages++;
+	vm_page_family->n_cached_vm_pages += vm_page->page_units;
+	
+	return mm_family_page_cache_trim(vm_page_family);
+}
+
+/*Let go of the family lock, then release the pages the caches dropped
+  while it was held*/
+static inline void
+mm_family_unlock(vm_page_family_t *vm_page_family){
+	
+	vm_page_t *batch = vm_page_family->release_pages;
+	
+	vm_page_family->release_pages = NULL;
+	MM_UNLOCK(&vm_page_family->family_lock);
+	
+	if(batch){
+		mm_page_cache_release(batch,
+			__atomic_load_n(&page_release_mode, __ATOMIC_RELAXED));
+	}
+}
+
+/*Reuse a retained page of units system pages, from the family cache
+  first. Pages of the global cache may be on any NUMA node, families
+  bound to one skip it. Caller holds the family lock*/
+static vm_page_t *
+mm_page_cache_get(vm_page_family_t *vm_page_family, uint32_t units){
+	
+	vm_page_t *vm_page;
+	
+	vm_page = mm_page_list_take(&vm_page_family->empty_pages, units);
+	if(vm_page){
+		vm_page_family->n_empty_pages--;
+		vm_page_family->n_cached_vm_pages -= vm_page->page_units;
+		return vm_page;
+	}
+	
+	if(vm_page_family->numa_node >= 0)
+		return NULL;
+	
+	MM_LOCK(&global_page_cache_lock);
+	vm_page = mm_page_list_take(&global_empty_pages, units);
+	if(vm_page)
+		n_global_empty_pages--;
+	MM_UNLOCK(&global_page_cache_lock);
+	return vm_page;
+}
+
+void
+mm_set_page_cache_watermarks(uint32_t low, uint32_t high){
+	
+	vm_page_t *batch;
+	mm_page_release_mode_t mode;
+	
+	if(low > high)
+		low = high;
+	
+	MM_LOCK(&global_page_cache_lock);
+	global_empty_pages_low = low;
+	global_empty_pages_high = high;
+	batch = mm_global_page_cache_trim();
+	MM_UNLOCK(&global_page_cache_lock);
+	mode = __atomic_load_n(&page_release_mode, __ATOMIC_RELAXED);
+	
+	mm_page_cache_release(batch, mode);
+}
+
+void
+mm_family_set_page_cache_watermarks(vm_page_family_t *vm_page_family,
+						uint32_t low, uint32_t high){
+	
+	vm_page_family_t *node_family;
+	vm_page_t *batch;
+	
+	if(low > high)
+		low = high;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	vm_page_family->empty_pages_low = low;
+	vm_page_family->empty_pages_high = high;
+	batch = mm_family_page_cache_trim(vm_page_family);
+	MM_UNLOCK(&vm_page_family->family_lock);
+	mm_page_cache_release(batch,
+		__atomic_load_n(&page_release_mode, __ATOMIC_RELAXED));
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_family_set_page_cache_watermarks(node_family, low, high);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+}
+
+void
+mm_set_page_release_mode(mm_page_release_mode_t mode){
+	
+	__atomic_store_n(&page_release_mode, mode, __ATOMIC_RELAXED);
+}
+
+void
+mm_trim_page_caches(){
+	
+	vm_page_family_t *vm_page_family_curr;
+	vm_page_t *batch;
+	mm_page_release_mode_t mode =
+		__atomic_load_n(&page_release_mode, __ATOMIC_RELAXED);
+	
+	MM_LOCK(&global_page_cache_lock);
+	batch = global_empty_pages;
+	global_empty_pages = NULL;
+	n_global_empty_pages = 0;
+	MM_UNLOCK(&global_page_cache_lock);
+	mm_page_cache_release(batch, mode);
+	
+	MM_REGISTRY_RDLOCK();
+	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
+		
+		MM_LOCK(&vm_page_family_curr->family_lock);
+		batch = vm_page_family_curr->empty_pages;
+		vm_page_family_curr->empty_pages = NULL;
+		vm_page_family_curr->n_empty_pages = 0;
+		vm_page_family_curr->n_cached_vm_pages = 0;
+		MM_UNLOCK(&vm_page_family_curr->family_lock);
+		mm_page_cache_release(batch, mode);
+		
+		/*Newest chunks are kept while in use, drop them once empty*/
+		MM_LOCK(&mm_chunk_lock);
+		while(vm_page_family_curr->chunks &&
+			  !vm_page_family_curr->chunks->used_units){
+			mm_chunk_unmap(vm_page_family_curr->chunks);
+		}
+		MM_UNLOCK(&mm_chunk_lock);
+	
+	} ITERATE_PAGE_FAMILIES_END(first_vm_page_for_families, vm_page_family_curr);
+	MM_REGISTRY_UNLOCK();
+}
+
+/*Leading bytes of the size bytes at app_data which may not be zero*/
+static inline uint32_t
+mm_vm_page_dirty_bytes(vm_page_t *vm_page, void *app_data, uint32_t size){
+	
+	uint32_t start = (uint32_t)((char *)app_data - (char *)vm_page);
+	
+	if(start >= vm_page->zero_offset)
+		return 0;
+	return vm_page->zero_offset - start < size ?
+			vm_page->zero_offset - start : size;
+}
+
+/*Everything in the page before end has been written*/
+static inline void
+mm_vm_page_mark_written(vm_page_t *vm_page, void *end){
+	
+	uint32_t offset = (uint32_t)((char *)end - (char *)vm_page);
+	
+	if(offset > vm_page->zero_offset)
+		vm_page->zero_offset = offset;
+}
+
+/*Return a fresh new virtual page*/
+vm_page_t *
+allocate_vm_page(vm_page_family_t *vm_page_family, int units){
+	
+	MM_LATENCY_START_ALWAYS(start);
+	vm_page_t *vm_page = mm_page_cache_get(vm_page_family, units);
+	mm_chunk_t *chunk = NULL;
+	vm_bool_t zeroed = MM_FALSE;
+	
+	/*Cached pages keep the chunk they were carved from*/
+	if(!vm_page){
+		if(units <= MM_MAX_SPAN_UNITS){
+			vm_page = mm_chunk_get_pages(&vm_page_family->chunks,
+						&vm_page_family->next_chunk_units,
+						vm_page_family->huge_pages, units, &chunk, &zeroed);
+		}
+		else{
+			vm_page = mm_get_new_vm_page_from_kernel(units);
+			zeroed = MM_TRUE;
+			if(vm_page){
+				if(vm_page_family->numa_node >= 0)
+					mm_numa_bind(vm_page, (size_t)units << SYSTEM_PAGE_SHIFT,
+						vm_page_family->numa_node);
+				__atomic_fetch_add(&vm_page_family->n_mmap_calls, 1,
+						__ATOMIC_RELAXED);
+			}
+		}
+		
+		if(!vm_page)
+			return NULL;
+		vm_page->chunk = chunk;
+	}
+	
+	MM_LATENCY_END(vm_page_family, MM_LATENCY_PAGE_ACQUIRE, start);
+	
+	/*The lower most meta block and its free list links are written*/
+	vm_page->zero_offset = zeroed ?
+			offset_of(vm_page_t, block_meta_data) + sizeof(block_meta_data_t) +
+				sizeof(glthread_t) :
+			(uint32_t)(units << SYSTEM_PAGE_SHIFT);
+	
+	vm_page->page_units = units;
+	vm_page->n_sampled = 0;
+	vm_page->free_bytes = 0;
+	
+	/*Set the back pointer to page family*/
+	vm_page->page_family = vm_page_family;
+	
+	if(!mm_pagemap_set(vm_page, units, vm_page)){
+		mm_vm_page_release(vm_page, MM_PAGE_RELEASE_MADV_DONTNEED);
+		return NULL;
+	}
+	
+	vm_page->page_type = MM_VM_PAGE_BLOCKS;
+	
+	/*Initialize lower most Meta block of the VM page*/
+	MARK_VM_PAGE_EMPTY(vm_page);
+	
+	vm_page->block_meta_data.block_size = mm_max_page_allocatable_memory(units);
+	
+	vm_page->block_meta_data.offset = offset_of(vm_page_t, block_meta_data);
+	vm_page->next = NULL;
+	vm_page->prev = NULL;
+	
+	vm_page_family->n_vm_pages += units;
+	
+	/*If it is a first VM data page for a given page family*/
+	if(!vm_page_family->first_page){
+		vm_page_family->first_page = vm_page;
+		return vm_page;
+	}
+	
+	/* Insert new VM page to the head of the linked list*/
+	vm_page->next = vm_page_family->first_page;
+	vm_page_family->first_page->prev = vm_page;
+	vm_page_family->first_page = vm_page;
+	return vm_page;
+}
+
+/*Take a VM data page off its family, the caller disposes of its memory*/
+static void
+mm_vm_page_unlink(vm_page_t *vm_page){
+	
+	vm_page_family_t *vm_page_family = vm_page->page_family;
+	uint32_t units = vm_page->page_units;
+	
+	mm_pagemap_set(vm_page, units, NULL);
+	vm_page_family->n_vm_pages -= units;
+	
+	/*If the page being deleted is the head of the linked list*/
+	if(vm_page_family->first_page == vm_page)
+	{
+		vm_page_family->first_page = vm_page->next;
+		if(vm_page->next)
+			vm_page->next->prev = NULL;
+		vm_page->next = NULL;
+		vm_page->prev = NULL;
+		return;
+	}
+	
+	/*If we are deleting the page from milddle or end of linked list*/
+	if(vm_page->next)
+		vm_page->next->prev = vm_page->prev;
+	vm_page->prev->next = vm_page->next;
+}
+
+/*Caller holds the family lock and lets go of it with mm_family_unlock()*/
+void mm_vm_page_delete_and_free(vm_page_t *vm_page){
+	
+	vm_page_family_t *vm_page_family = vm_page->page_family;
+	vm_page_t *batch, *last;
+	
+	mm_vm_page_unlink(vm_page);
+	batch = mm_page_cache_put(vm_page);
+	if(!batch)
+		return;
+	
+	for(last = batch; last->next; last = last->next);
+	last->next = vm_page_family->release_pages;
+	vm_page_family->release_pages = batch;
+}
+
+
+static void
+mm_add_free_block_meta_data_to_free_block_list(
+					vm_page_family_t *vm_page_family,
+					block_meta_data_t *free_block){
+	
+	uint32_t fl, sl;
+	glthread_t *prev;
+	
+	assert(free_block->is_free == MM_TRUE);
+	
+	mm_free_block_list_mapping(free_block->block_size, &fl, &sl);
+	
+	init_glthread(MM_FREE_BLOCK_GLUE(free_block));
+	prev = &vm_page_family->free_block_lists[fl][sl];
+	
+	/*First fit lists are kept in address order*/
+	if((vm_page_family->flags & MM_FAMILY_PLACEMENT_MASK) == MM_FAMILY_FIRST_FIT){
+		while(prev->right && prev->right < MM_FREE_BLOCK_GLUE(free_block))
+			prev = prev->right;
+	}
+	glthread_add_next(prev, MM_FREE_BLOCK_GLUE(free_block));
+	
+	((vm_page_t *)MM_GET_PAGE_FROM_META_BLOCK(free_block))->free_bytes +=
+		free_block->block_size;
+	vm_page_family->free_block_fl_bitmap |= (1u << fl);
+	vm_page_family->free_block_sl_bitmap[fl] |= (1u << sl);
+	vm_page_family->n_free_blocks++;
+}
+
+/*Must be called before the block_size of a listed free block changes*/
+static void
+mm_remove_free_block_meta_data_from_free_block_list(
+					vm_page_family_t *vm_page_family,
+					block_meta_data_t *free_block){
+	
+	uint32_t fl, sl;
+	
+	assert(free_block->is_free == MM_TRUE);
+	
+	mm_free_block_list_mapping(free_block->block_size, &fl, &sl);
+	
+	remove_glthread(MM_FREE_BLOCK_GLUE(free_block));
+	vm_page_family->n_free_blocks--;
+	((vm_page_t *)MM_GET_PAGE_FROM_META_BLOCK(free_block))->free_bytes -=
+		free_block->block_size;
+	
+	if(!vm_page_family->free_block_lists[fl][sl].right){
+		vm_page_family->free_block_sl_bitmap[fl] &= ~(1u << sl);
+		if(!vm_page_family->free_block_sl_bitmap[fl])
+			vm_page_family->free_block_fl_bitmap &= ~(1u << fl);
+	}
+}
+
+/*Good fit search : rounds req_size up to the next class boundary so
+  that any block in the first non empty class at or above it fits*/
+static block_meta_data_t *
+mm_find_free_block_page_family(
+		vm_page_family_t *vm_page_family,
+		uint32_t req_size){
+	
+	uint32_t fl, sl, sl_bitmap, fl_bitmap;
+	uint32_t search_size = req_size;
+	glthread_t *curr;
+	block_meta_data_t *block_meta_data;
+	
+	if(search_size >= (1u << MM_FREE_BLOCK_FL_SHIFT) &&
+		search_size < (1u << (MM_FREE_BLOCK_FL_MAX + 1))){
+		search_size += (1u << ((31 - __builtin_clz(search_size)) -
+						MM_FREE_BLOCK_SL_COUNT_LOG2)) - 1;
+	}
+	
+	mm_free_block_list_mapping(search_size, &fl, &sl);
+	
+	sl_bitmap = vm_page_family->free_block_sl_bitmap[fl] & (~0u << sl);
+	
+	if(!sl_bitmap){
+		fl_bitmap = fl + 1 < 32 ?
+			vm_page_family->free_block_fl_bitmap & (~0u << (fl + 1)) : 0;
+		if(!fl_bitmap)
+			return NULL;
+		fl = __builtin_ctz(fl_bitmap);
+		sl_bitmap = vm_page_family->free_block_sl_bitmap[fl];
+	}
+	
+	sl = __builtin_ctz(sl_bitmap);
+	
+	/*Only the last, unbounded class can hold blocks smaller than req_size*/
+	ITERATE_GLTHREAD_BEGIN(&vm_page_family->free_block_lists[fl][sl], curr){
+		
+		block_meta_data = glthread_to_block_meta_data(curr);
+		if(block_meta_data->block_size >= req_size)
+			return block_meta_data;
+		
+	} ITERATE_GLTHREAD_END(&vm_page_family->free_block_lists[fl][sl], curr);
+	
+	return NULL;
+}
+
+/*Moves fl, sl to the first non empty size class at or above them.
+  Returns MM_FALSE when there is none*/
+static inline vm_bool_t
+mm_next_free_block_class(vm_page_family_t *vm_page_family,
+						 uint32_t *fl, uint32_t *sl){
+	
+	uint32_t sl_bitmap = 0, fl_bitmap;
+	
+	if(*sl < MM_FREE_BLOCK_SL_COUNT)
+		sl_bitmap = vm_page_family->free_block_sl_bitmap[*fl] & (~0u << *sl);
+	
+	if(!sl_bitmap){
+		fl_bitmap = vm_page_family->free_block_fl_bitmap & (~0u << (*fl + 1));
+		if(!fl_bitmap)
+			return MM_FALSE;
+		*fl = __builtin_ctz(fl_bitmap);
+		sl_bitmap = vm_page_family->free_block_sl_bitmap[*fl];
+	}
+	
+	*sl = __builtin_ctz(sl_bitmap);
+	return MM_TRUE;
+}
+
+/*Whether the page of a holds fewer free bytes per system page than
+  the page of b*/
+static inline vm_bool_t
+mm_free_block_page_denser(block_meta_data_t *a, block_meta_data_t *b){
+	
+	vm_page_t *page_a = MM_GET_PAGE_FROM_META_BLOCK(a);
+	vm_page_t *page_b = MM_GET_PAGE_FROM_META_BLOCK(b);
+	
+	return (uint64_t)page_a->free_bytes * page_b->page_units <
+		(uint64_t)page_b->free_bytes * page_a->page_units;
+}
+
+/*Best fit and densest page placement : looks at up to
+  MM_PLACEMENT_SCAN_MAX free blocks from the size class of req_size
+  upwards, for the smallest one or the one of the fullest page. Blocks
+  of higher classes are all bigger, best fit stops at the first class
+  with a fitting block*/
+static block_meta_data_t *
+mm_scan_free_blocks_page_family(vm_page_family_t *vm_page_family,
+								uint32_t req_size, vm_bool_t densest){
+	
+	block_meta_data_t *block_meta_data, *best = NULL;
+	uint32_t fl, sl, n_scanned = 0;
+	glthread_t *curr;
+	
+	mm_free_block_list_mapping(req_size, &fl, &sl);
+	
+	while(n_scanned < MM_PLACEMENT_SCAN_MAX &&
+			mm_next_free_block_class(vm_page_family, &fl, &sl)){
+		
+		ITERATE_GLTHREAD_BEGIN(&vm_page_family->free_block_lists[fl][sl], curr){
+			
+			block_meta_data = glthread_to_block_meta_data(curr);
+			if(block_meta_data->block_size >= req_size &&
+				(!best || (densest ?
+					mm_free_block_page_denser(block_meta_data, best) :
+					block_meta_data->block_size < best->block_size))){
+				best = block_meta_data;
+			}
+			if(++n_scanned == MM_PLACEMENT_SCAN_MAX)
+				break;
+			
+		} ITERATE_GLTHREAD_END(&vm_page_family->free_block_lists[fl][sl], curr);
+		
+		if(best && !densest)
+			break;
+		sl++;
+	}
+	
+	/*The class of req_size only held smaller blocks*/
+	if(!best)
+		best = mm_find_free_block_page_family(vm_page_family, req_size);
+	return best;
+}
+
+/*Address ordered first fit placement : the lists are sorted by address,
+  the lowest fitting block is the first fitting one of some class. Only
+  the class of req_size may hold blocks too small, up to
+  MM_PLACEMENT_SCAN_MAX of them are looked at*/
+static block_meta_data_t *
+mm_first_fit_free_block_page_family(vm_page_family_t *vm_page_family,
+									uint32_t req_size){
+	
+	block_meta_data_t *block_meta_data, *first = NULL;
+	uint32_t fl, sl, n_scanned = 0;
+	glthread_t *curr;
+	
+	mm_free_block_list_mapping(req_size, &fl, &sl);
+	
+	while(mm_next_free_block_class(vm_page_family, &fl, &sl)){
+		
+		ITERATE_GLTHREAD_BEGIN(&vm_page_family->free_block_lists[fl][sl], curr){
+			
+			block_meta_data = glthread_to_block_meta_data(curr);
+			if(first && block_meta_data > first)
+				break;
+			if(block_meta_data->block_size >= req_size){
+				first = block_meta_data;
+				break;
+			}
+			if(++n_scanned == MM_PLACEMENT_SCAN_MAX)
+				break;
+			
+		} ITERATE_GLTHREAD_END(&vm_page_family->free_block_lists[fl][sl], curr);
+		
+		sl++;
+	}
+	return first;
+}
+
+/*Free block req_size bytes are carved from under the placement policy
+  of the family, NULL when a new page is needed*/
+static block_meta_data_t *
+mm_place_free_block_page_family(vm_page_family_t *vm_page_family,
+								uint32_t req_size){
+	
+	block_meta_data_t *block_meta_data;
+	
+	switch(vm_page_family->flags & MM_FAMILY_PLACEMENT_MASK){
+		
+		case MM_FAMILY_BEST_FIT:
+			return mm_scan_free_blocks_page_family(vm_page_family,
+						req_size, MM_FALSE);
+		case MM_FAMILY_DENSEST_PAGE:
+			return mm_scan_free_blocks_page_family(vm_page_family,
+						req_size, MM_TRUE);
+		case MM_FAMILY_FIRST_FIT:
+			return mm_first_fit_free_block_page_family(vm_page_family,
+						req_size);
+		default:
+			break;
+	}
+	
+	/*Worst fit. The biggest class holds blocks of roughly equal size, the
+	  one picked may fall short while another block still fits the request*/
+	block_meta_data = mm_get_biggest_free_block_page_family(vm_page_family);
+	if(block_meta_data && block_meta_data->block_size < req_size)
+		block_meta_data = mm_find_free_block_page_family(vm_page_family,
+								req_size);
+	return block_meta_data;
+}
+
+
+static vm_page_t * 
+mm_family_new_page_add(vm_page_family_t *vm_page_family, int units){
+	
+	vm_page_t *vm_page = allocate_vm_page(vm_page_family, units);
+	
+	if(!vm_page)
+		return NULL;
+	
+	/* The new page is like one free block, add it to 
+	    free block list*/
+	mm_add_free_block_meta_data_to_free_block_list(
+		vm_page_family, &vm_page->block_meta_data);
+		
+	return vm_page;
+}
+
+
+static vm_bool_t
+mm_split_free_data_block_for_allocation(
+					vm_page_family_t *vm_page_family,
+					block_meta_data_t *block_meta_data,
+					uint32_t size){
+	
+	block_meta_data_t *next_block_meta_data = NULL;
+	
+	assert(block_meta_data->is_free == MM_TRUE);
+	
+	if(block_meta_data->block_size < size){
+		return MM_FALSE;
+	}
+	
+	uint32_t remaining_size = 
+				block_meta_data->block_size - size;
+	
+	mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, block_meta_data);
+	block_meta_data->is_free = MM_FALSE;
+	block_meta_data->block_size = size;
+	/*block_meta_data->offset remains unchanged*/
+	
+	/*Case 1: No split*/
+	if(!remaining_size){
+		return MM_TRUE;	
+	}
+	
+	/*Case 3: Hard Internal Fragmentation : too small for a free block,
+	  the allocated block keeps the remaining bytes*/
+	if(remaining_size < sizeof(block_meta_data_t) + MM_MIN_BLOCK_SIZE){
+		block_meta_data->block_size += remaining_size;
+		return MM_TRUE;
+	}
+	
+	/*Case 2: Full split, or Case 3: Soft Internal Fragmentation when the
+	  new free block cannot hold an object : New Meta block is created*/
+	next_block_meta_data = NEXT_META_BLOCK_BY_SIZE(block_meta_data);
+	next_block_meta_data->is_free = MM_TRUE;
+	next_block_meta_data->block_size = 
+			remaining_size - sizeof(block_meta_data_t);
+	next_block_meta_data->offset = block_meta_data->offset + 
+			sizeof(block_meta_data_t) + block_meta_data->block_size;
+	
+	/*To fix up linkages*/
+	mm_bind_blocks_for_allocation(block_meta_data, next_block_meta_data);
+	
+	/*Insert new free block into its size class list*/
+	mm_add_free_block_meta_data_to_free_block_list(
+				vm_page_family, next_block_meta_data);
+	
+	return MM_TRUE;
+
+}
+
+
+
+
+
+/*Resize an allocated block in place to size bytes, growing into the
+  free block right after it. A tail big enough for a free block is split
+  off and merged with a free block following it. Returns whether the
+  block now holds size bytes, the caller holds the family lock*/
+static vm_bool_t
+mm_resize_data_block(vm_page_family_t *vm_page_family,
+					 block_meta_data_t *block_meta_data, uint32_t size){
+	
+	vm_page_t *vm_page = MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+	block_meta_data_t *next_block = NEXT_META_BLOCK(block_meta_data);
+	block_meta_data_t *following_block;
+	uint32_t remaining_size;
+	
+	assert(block_meta_data->is_free == MM_FALSE);
+	
+	if(size > block_meta_data->block_size){
+		
+		if(!next_block || !next_block->is_free ||
+			block_meta_data->block_size + sizeof(block_meta_data_t) +
+				next_block->block_size < size){
+			return MM_FALSE;
+		}
+		
+		mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, next_block);
+		block_meta_data->block_size += sizeof(block_meta_data_t) +
+				next_block->block_size;
+		next_block = NEXT_META_BLOCK(block_meta_data);
+		if(next_block)
+			next_block->prev_offset = block_meta_data->offset;
+	}
+	
+	/*The application may write anywhere in the block*/
+	mm_vm_page_mark_written(vm_page,
+		(char *)(block_meta_data + 1) + block_meta_data->block_size);
+	
+	remaining_size = block_meta_data->block_size - size;
+	
+	/*Hard internal fragmentation stays with the block*/
+	if(remaining_size < sizeof(block_meta_data_t) + MM_MIN_BLOCK_SIZE)
+		return MM_TRUE;
+	
+	block_meta_data->block_size = size;
+	next_block = NEXT_META_BLOCK_BY_SIZE(block_meta_data);
+	next_block->is_free = MM_TRUE;
+	next_block->block_size = remaining_size - sizeof(block_meta_data_t);
+	next_block->offset = block_meta_data->offset +
+			sizeof(block_meta_data_t) + size;
+	mm_bind_blocks_for_allocation(block_meta_data, next_block);
+	
+	following_block = NEXT_META_BLOCK(next_block);
+	if(following_block && following_block->is_free){
+		mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, following_block);
+		mm_union_free_blocks(next_block, following_block);
+	}
+	
+	mm_add_free_block_meta_data_to_free_block_list(vm_page_family, next_block);
+	return MM_TRUE;
+}
+
+/*Move the start of a listed free block forward so that its data lands
+  on an align boundary, the bytes skipped become a free block of their
+  own. Returns the aligned free block, the caller made sure it keeps
+  room for its request*/
+static block_meta_data_t *
+mm_align_free_data_block(vm_page_family_t *vm_page_family,
+						 block_meta_data_t *block_meta_data, uint32_t align){
+	
+	uint32_t gap = (uint32_t)(-(uintptr_t)(block_meta_data + 1) & (align - 1));
+	block_meta_data_t *aligned_block, *next_block;
+	
+	if(!gap)
+		return block_meta_data;
+	
+	while(gap < sizeof(block_meta_data_t) + MM_MIN_BLOCK_SIZE)
+		gap += align;
+	
+	mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, block_meta_data);
+	
+	aligned_block = (block_meta_data_t *)((char *)block_meta_data + gap);
+	aligned_block->is_free = MM_TRUE;
+	aligned_block->block_size = block_meta_data->block_size - gap;
+	aligned_block->offset = block_meta_data->offset + gap;
+	aligned_block->prev_offset = block_meta_data->offset;
+	block_meta_data->block_size = gap - sizeof(block_meta_data_t);
+	
+	next_block = NEXT_META_BLOCK(aligned_block);
+	if(next_block)
+		next_block->prev_offset = aligned_block->offset;
+	
+	mm_vm_page_mark_written(MM_GET_PAGE_FROM_META_BLOCK(aligned_block),
+		(char *)(aligned_block + 1) + sizeof(glthread_t));
+	
+	mm_add_free_block_meta_data_to_free_block_list(vm_page_family,
+		block_meta_data);
+	mm_add_free_block_meta_data_to_free_block_list(vm_page_family,
+		aligned_block);
+	return aligned_block;
+}
+
+/*Large requests get a dedicated VM data page holding one allocated
+  block, it never enters the free block lists and goes back to the
+  kernel as soon as the block is freed*/
+static vm_page_t *
+mm_family_new_large_page_add(vm_page_family_t *vm_page_family,
+							 uint32_t req_size){
+	
+	uint32_t units = (uint32_t)((offset_of(vm_page_t, page_memory) + req_size +
+						SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+	
+	vm_page_t *vm_page = allocate_vm_page(vm_page_family, units);
+	
+	if(!vm_page)
+		return NULL;
+	
+	vm_page->page_type = MM_VM_PAGE_LARGE;
+	vm_page->block_meta_data.is_free = MM_FALSE;
+	return vm_page;
+}
+
+/*Resize a dedicated region to units system pages. A region carved from
+  a chunk grows over the free pages following it, one mapped on its own
+  through mremap(), which may move it. Returns the region, NULL when it
+  could not be resized. The caller holds the family lock*/
+static vm_page_t *
+mm_large_page_resize(vm_page_t *vm_page, uint32_t units){
+	
+	vm_page_family_t *vm_page_family = vm_page->page_family;
+	uint32_t old_units = vm_page->page_units;
+	size_t old_length = (size_t)old_units << SYSTEM_PAGE_SHIFT;
+	size_t length = (size_t)units << SYSTEM_PAGE_SHIFT;
+	vm_page_t *new_page = vm_page;
+	/*First system page dropped or added*/
+	vm_page_t *tail = (vm_page_t *)((char *)vm_page +
+						(units < old_units ? length : old_length));
+	
+	assert(vm_page->page_type == MM_VM_PAGE_LARGE);
+	
+	if(units < old_units){
+		mm_pagemap_set(tail, old_units - units, NULL);
+		if(vm_page->chunk){
+			mm_chunk_put_pages(vm_page->chunk, tail, old_units - units,
+				__atomic_load_n(&page_release_mode, __ATOMIC_RELAXED));
+		}
+		else if(munmap(tail, old_length - length)){
+			printf("Error : %s() Could not munmap region tail\n", __FUNCTION__);
+		}
+	}
+	else if(units > old_units){
+		
+		if(vm_page->chunk){
+			if(!mm_chunk_extend_pages(vm_page->chunk, vm_page, old_units, units))
+				return NULL;
+		}
+		else{
+			new_page = mremap(vm_page, old_length, length, MREMAP_MAYMOVE);
+			if(new_page == MAP_FAILED)
+				return NULL;
+		}
+		
+		/*The old range stays mapped until the new one is*/
+		if(!mm_pagemap_set(new_page, units, new_page)){
+			if(new_page == vm_page)
+				mm_pagemap_set(tail, units - old_units, NULL);
+			if(vm_page->chunk)
+				mm_chunk_put_pages(vm_page->chunk, tail, units - old_units,
+					MM_PAGE_RELEASE_MADV_DONTNEED);
+			else if(new_page == vm_page)
+				mremap(vm_page, length, old_length, 0);
+			else
+				mremap(new_page, length, old_length,
+					MREMAP_MAYMOVE|MREMAP_FIXED, vm_page);
+			return NULL;
+		}
+		
+		if(new_page != vm_page){
+			mm_pagemap_set(vm_page, old_units, NULL);
+			if(new_page->prev)
+				new_page->prev->next = new_page;
+			else
+				vm_page_family->first_page = new_page;
+			if(new_page->next)
+				new_page->next->prev = new_page;
+		}
+	}
+	
+	new_page->page_units = units;
+	new_page->block_meta_data.block_size = mm_max_page_allocatable_memory(units);
+	vm_page_family->n_vm_pages += units;
+	vm_page_family->n_vm_pages -= old_units;
+	return new_page;
+}
+
+static block_meta_data_t *
+mm_allocate_free_data_block(
+		vm_page_family_t *vm_page_family,
+		uint32_t req_size, uint32_t align){
+	
+	vm_bool_t status = MM_FALSE;
+	vm_page_t *vm_page = NULL;
+	uint32_t slack = 0, data_offset;
+	
+	if(!req_size)
+		return NULL;
+	
+	req_size = mm_family_block_size(vm_page_family, req_size);
+	
+	/*Blocks start their data on the family alignment, a stricter one
+	  may cost a free block in front of the data*/
+	if(align > vm_page_family->object_align)
+		slack = align + sizeof(block_meta_data_t) + MM_MIN_BLOCK_SIZE;
+	
+	if(req_size > vm_page_family->large_threshold ||
+		req_size + slack > mm_max_page_allocatable_memory(vm_page_family->span_units)){
+		
+		/*Otherwise the data is aligned inside the region*/
+		data_offset = offset_of(vm_page_t, block_meta_data) + sizeof(block_meta_data_t);
+		if(align <= SYSTEM_PAGE_SIZE && !(data_offset & (align - 1)))
+			align = 0;
+		
+		vm_page = mm_family_new_large_page_add(vm_page_family, req_size + align);
+		return vm_page ? &vm_page->block_meta_data : NULL;
+	}
+	
+	block_meta_data_t *free_block_meta_data =
+		mm_place_free_block_page_family(vm_page_family, req_size + slack);
+	
+	if(!free_block_meta_data){
+		
+		/*Time to add a new ppage to page family to satisfy the request*/
+		vm_page = mm_family_new_page_add(vm_page_family,
+						vm_page_family->span_units);
+		
+		if(!vm_page)
+			return NULL;
+		
+		free_block_meta_data = &vm_page->block_meta_data;
+	}
+	
+	if(slack){
+		free_block_meta_data = mm_align_free_data_block(vm_page_family,
+				free_block_meta_data, align);
+	}
+	
+	/*The free block meta data can satisfy the request*/
+	status = mm_split_free_data_block_for_allocation(vm_page_family,
+				free_block_meta_data, req_size);
+	
+	if(status)
+		return free_block_meta_data;
+	
+	return NULL;
+	
+}
+
+
+/*Slab pages : a page is carved into equal slots, a free slot is found
+  with a find first zero bit over the occupancy bitmap. Pages with at
+  least one free slot are kept on the partial slab list of the family*/
+static vm_page_t *
+mm_family_new_slab_page_add(vm_page_family_t *vm_page_family){
+	
+	vm_page_t *vm_page = allocate_vm_page(vm_page_family,
+							vm_page_family->span_units);
+	vm_slab_meta_data_t *slab_meta_data;
+	uint64_t *bitmap;
+	uint32_t n_words;
+	
+	if(!vm_page)
+		return NULL;
+	
+	vm_page->page_type = MM_VM_PAGE_SLAB;
+	slab_meta_data = &vm_page->slab_meta_data;
+	slab_meta_data->slot_size = mm_family_slot_size(vm_page_family->struct_size,
+									vm_page_family->flags);
+	slab_meta_data->n_objects = mm_slab_geometry(slab_meta_data->slot_size,
+								vm_page->page_units,
+								&slab_meta_data->first_slot_offset);
+	slab_meta_data->n_free = slab_meta_data->n_objects;
+	slab_meta_data->free_word_hint = 0;
+	vm_page_family->n_free_blocks += slab_meta_data->n_objects;
+	
+	/*All slots are free, bits past the last slot are marked occupied*/
+	bitmap = MM_SLAB_BITMAP(vm_page);
+	n_words = (slab_meta_data->n_objects + 63) / 64;
+	memset(bitmap, 0, n_words * sizeof(uint64_t));
+	if(slab_meta_data->n_objects % 64)
+		bitmap[n_words - 1] = ~0ull << (slab_meta_data->n_objects % 64);
+	
+	if(vm_page->zero_offset < slab_meta_data->first_slot_offset)
+		vm_page->zero_offset = slab_meta_data->first_slot_offset;
+	
+	init_glthread(&slab_meta_data->partial_slab_glue);
+	glthread_add_next(&vm_page_family->partial_slab_list_head,
+			&slab_meta_data->partial_slab_glue);
+	return vm_page;
+}
+
+static void *
+mm_slab_allocate_object(vm_page_family_t *vm_page_family, vm_bool_t *known_zero){
+	
+	vm_page_t *vm_page;
+	vm_slab_meta_data_t *slab_meta_data;
+	uint64_t *bitmap;
+	uint32_t word, bit;
+	void *app_data;
+	
+	if(vm_page_family->partial_slab_list_head.right){
+		vm_page = glthread_to_vm_page_slab(
+				vm_page_family->partial_slab_list_head.right);
+	}
+	else{
+		vm_page = mm_family_new_slab_page_add(vm_page_family);
+		if(!vm_page)
+			return NULL;
+	}
+	
+	slab_meta_data = &vm_page->slab_meta_data;
+	bitmap = MM_SLAB_BITMAP(vm_page);
+	
+	/*A partial page has a free slot at or above the hint*/
+	for(word = slab_meta_data->free_word_hint; !~bitmap[word]; word++);
+	
+	bit = __builtin_ctzll(~bitmap[word]);
+	bitmap[word] |= (1ull << bit);
+	slab_meta_data->free_word_hint = word;
+	
+	vm_page_family->n_free_blocks--;
+	if(--slab_meta_data->n_free == 0)
+		remove_glthread(&slab_meta_data->partial_slab_glue);
+	
+	app_data = MM_SLAB_SLOT(vm_page, word * 64 + bit);
+	*known_zero = mm_vm_page_dirty_bytes(vm_page, app_data,
+					slab_meta_data->slot_size) ? MM_FALSE : MM_TRUE;
+	mm_vm_page_mark_written(vm_page,
+		(char *)app_data + slab_meta_data->slot_size);
+	return app_data;
+}
+
+static void
+mm_slab_free_object(vm_page_t *vm_page, void *app_data){
+	
+	vm_page_family_t *vm_page_family = vm_page->page_family;
+	vm_slab_meta_data_t *slab_meta_data = &vm_page->slab_meta_data;
+	uint64_t *bitmap = MM_SLAB_BITMAP(vm_page);
+	uint32_t index = (uint32_t)(((char *)app_data - (char *)vm_page -
+				slab_meta_data->first_slot_offset) / slab_meta_data->slot_size);
+	uint32_t word = index / 64, bit = index % 64;
+	
+	assert(MM_SLAB_SLOT(vm_page, index) == app_data);
+	assert(bitmap[word] & (1ull << bit));
+	
+	bitmap[word] &= ~(1ull << bit);
+	
+	if(word < slab_meta_data->free_word_hint)
+		slab_meta_data->free_word_hint = word;
+	
+	vm_page_family->n_free_blocks++;
+	
+	/*Page was full, it becomes a partial page again*/
+	if(slab_meta_data->n_free++ == 0){
+		glthread_add_next(&vm_page_family->partial_slab_list_head,
+				&slab_meta_data->partial_slab_glue);
+	}
+	
+	if(mm_is_vm_page_empty(vm_page)){
+		remove_glthread(&slab_meta_data->partial_slab_glue);
+		vm_page_family->n_free_blocks -= slab_meta_data->n_objects;
+		mm_vm_page_delete_and_free(vm_page);
+	}
+}
+
+
+/*Allocate 'req_size' bytes of application data aligned to align, at
+  least the family alignment, from the page family. *known_zero tells
+  whether they still hold zeros. The caller holds the family lock*/
+static void *
+mm_family_allocate(vm_page_family_t *vm_page_family, uint32_t req_size,
+				   uint32_t align, vm_bool_t *known_zero){
+	
+	block_meta_data_t *free_block_meta_data = NULL;
+	vm_page_t *vm_page;
+	void *app_data;
+	uint32_t dirty_bytes;
+	
+	/*Single objects of a slab family skip the data block path, slots are
+	  aligned to the family alignment*/
+	if((vm_page_family->flags & MM_FAMILY_SLAB) &&
+			req_size <= vm_page_family->struct_size &&
+			align <= vm_page_family->object_align){
+		return mm_slab_allocate_object(vm_page_family, known_zero);
+	}
+	
+	/*Find the page which can satisfy the request*/
+	free_block_meta_data = mm_allocate_free_data_block(
+					vm_page_family, req_size, align);
+	
+	if(!free_block_meta_data)
+		return NULL;
+	
+	vm_page = MM_GET_PAGE_FROM_META_BLOCK(free_block_meta_data);
+	app_data = (void *)(free_block_meta_data + 1);
+	
+	/*Dedicated regions are over allocated to align the data inside*/
+	if(vm_page->page_type == MM_VM_PAGE_LARGE)
+		app_data = (void *)MM_ALIGN_UP_TO((uintptr_t)app_data, (uintptr_t)align);
+	
+	dirty_bytes = mm_vm_page_dirty_bytes(vm_page, app_data,
+					free_block_meta_data->block_size);
+	
+	/*A split leaves the meta block and the free list links of the
+	  remaining free block right after the data*/
+	mm_vm_page_mark_written(vm_page, (char *)app_data +
+		free_block_meta_data->block_size + sizeof(block_meta_data_t) +
+		sizeof(glthread_t));
+	
+	/*Fresh memory only had the free list links written into it*/
+	if(dirty_bytes <= sizeof(glthread_t)){
+		memset(app_data, 0, dirty_bytes);
+		dirty_bytes = 0;
+	}
+	
+	*known_zero = dirty_bytes ? MM_FALSE : MM_TRUE;
+	return app_data;
+}
+
+/*Carve up to n blocks of size bytes back to back out of one free block,
+  whatever is left becomes a single free block again. Returns the number
+  of blocks carved, the caller holds the family lock*/
+static uint32_t
+mm_bulk_split_free_data_block(vm_page_family_t *vm_page_family,
+							  block_meta_data_t *block_meta_data,
+							  uint32_t size, uint32_t n, vm_bool_t zero,
+							  void **out){
+	
+	vm_page_t *vm_page = MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+	block_meta_data_t *curr = block_meta_data, *next;
+	uint32_t stride = sizeof(block_meta_data_t) + size;
+	uint32_t count, remaining_size, i;
+	
+	assert(block_meta_data->is_free == MM_TRUE);
+	assert(block_meta_data->block_size >= size);
+	
+	/*Every block after the first one brings its own meta block*/
+	count = 1 + (block_meta_data->block_size - size) / stride;
+	if(count > n)
+		count = n;
+	remaining_size = block_meta_data->block_size - size - (count - 1) * stride;
+	
+	mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, block_meta_data);
+	
+	for(i = 0; i < count; i++){
+		if(i){
+			next = NEXT_META_BLOCK_BY_SIZE(curr);
+			next->offset = curr->offset + stride;
+			next->prev_offset = curr->offset;
+			curr = next;
+		}
+		curr->is_free = MM_FALSE;
+		curr->block_size = size;
+		out[i] = (void *)(curr + 1);
+		
+		/*zero_offset only moves once all blocks are carved*/
+		if(zero)
+			memset(out[i], 0, mm_vm_page_dirty_bytes(vm_page, out[i], size));
+	}
+	
+	if(remaining_size >= sizeof(block_meta_data_t) + MM_MIN_BLOCK_SIZE){
+		next = NEXT_META_BLOCK_BY_SIZE(curr);
+		next->is_free = MM_TRUE;
+		next->block_size = remaining_size - sizeof(block_meta_data_t);
+		next->offset = curr->offset + stride;
+		mm_bind_blocks_for_allocation(curr, next);
+		mm_add_free_block_meta_data_to_free_block_list(vm_page_family, next);
+	}
+	else{
+		/*Hard internal fragmentation goes to the last block*/
+		curr->block_size += remaining_size;
+		next = NEXT_META_BLOCK(curr);
+		if(next)
+			next->prev_offset = curr->offset;
+	}
+	
+	mm_vm_page_mark_written(vm_page, (char *)(curr + 1) + curr->block_size +
+		sizeof(block_meta_data_t) + sizeof(glthread_t));
+	return count;
+}
+
+/*Allocate n objects of req_size bytes from the page family into out.
+  Returns the number allocated, fewer than n only when out of memory.
+  The caller holds the family lock*/
+static uint32_t
+mm_family_allocate_bulk(vm_page_family_t *vm_page_family, uint32_t req_size,
+						uint32_t n, vm_bool_t zero, void **out){
+	
+	block_meta_data_t *block_meta_data;
+	vm_page_t *vm_page;
+	vm_bool_t known_zero;
+	uint32_t count = 0, size = mm_family_block_size(vm_page_family, req_size);
+	
+	/*Slab slots and dedicated regions have no free block to carve from*/
+	if(((vm_page_family->flags & MM_FAMILY_SLAB) &&
+			req_size <= vm_page_family->struct_size) ||
+		size > vm_page_family->large_threshold ||
+		size > mm_max_page_allocatable_memory(vm_page_family->span_units)){
+		
+		for(; count < n; count++){
+			out[count] = mm_family_allocate(vm_page_family, req_size,
+							vm_page_family->object_align, &known_zero);
+			if(!out[count])
+				break;
+			if(zero && !known_zero)
+				memset(out[count], 0, req_size);
+		}
+		return count;
+	}
+	
+	while(count < n){
+		
+		block_meta_data = mm_place_free_block_page_family(vm_page_family, size);
+		
+		if(!block_meta_data){
+			vm_page = mm_family_new_page_add(vm_page_family,
+							vm_page_family->span_units);
+			if(!vm_page)
+				break;
+			block_meta_data = &vm_page->block_meta_data;
+		}
+		
+		count += mm_bulk_split_free_data_block(vm_page_family, block_meta_data,
+					size, n - count, zero, out + count);
+	}
+	return count;
+}
+
+static block_meta_data_t *
+mm_free_blocks(block_meta_data_t *to_be_free_block);
+
+/*Return application data to its page family, the caller holds the
+  family lock*/
+static void
+mm_family_free(vm_page_t *hosting_page, void *app_data){
+	
+	if(hosting_page->page_type == MM_VM_PAGE_SLAB){
+		mm_slab_free_object(hosting_page, app_data);
+		return;
+	}
+	
+	if(hosting_page->page_type == MM_VM_PAGE_LARGE){
+		assert(hosting_page->block_meta_data.is_free == MM_FALSE);
+		mm_vm_page_delete_and_free(hosting_page);
+		return;
+	}
+	
+	block_meta_data_t *block_meta_data = 
+		(block_meta_data_t *)((char *)app_data - sizeof(block_meta_data_t));
+	
+	assert(block_meta_data->is_free == MM_FALSE);
+	mm_free_blocks(block_meta_data);
+}
+
+/*Return n blocks of data pages of the page family at once. The blocks
+  are all marked free first, then every run of neighbouring free blocks
+  is merged into one block which enters its size class list once. A free
+  block off the lists has a NULL left link, a listed one never has.
+  Returns the bytes freed, the caller holds the family lock*/
+static uint64_t
+mm_family_free_blocks_bulk(vm_page_family_t *vm_page_family,
+						   void **app_data, uint32_t n){
+	
+	block_meta_data_t *block_meta_data, *prev_block, *next_block;
+	glthread_t empty_pages, *curr;
+	vm_page_t *vm_page;
+	uint64_t bytes_freed = 0;
+	uint32_t i;
+	
+	for(i = 0; i < n; i++){
+		block_meta_data = (block_meta_data_t *)app_data[i] - 1;
+		assert(block_meta_data->is_free == MM_FALSE);
+		bytes_freed += block_meta_data->block_size;
+		block_meta_data->is_free = MM_TRUE;
+		init_glthread(MM_FREE_BLOCK_GLUE(block_meta_data));
+	}
+	
+	init_glthread(&empty_pages);
+	
+	for(i = 0; i < n; i++){
+		
+		block_meta_data = (block_meta_data_t *)app_data[i] - 1;
+		
+		/*Already merged into a run, or the head of one*/
+		if(!block_meta_data->is_free ||
+				MM_FREE_BLOCK_GLUE(block_meta_data)->left){
+			continue;
+		}
+		
+		while((prev_block = PREV_META_BLOCK(block_meta_data)) &&
+				prev_block->is_free){
+			block_meta_data = prev_block;
+		}
+		
+		if(MM_FREE_BLOCK_GLUE(block_meta_data)->left)
+			mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, block_meta_data);
+		
+		/*Merged blocks are marked busy so that later entries skip them*/
+		while((next_block = NEXT_META_BLOCK(block_meta_data)) &&
+				next_block->is_free){
+			if(MM_FREE_BLOCK_GLUE(next_block)->left)
+				mm_remove_free_block_meta_data_from_free_block_list(
+					vm_page_family, next_block);
+			mm_union_free_blocks(block_meta_data, next_block);
+			next_block->is_free = MM_FALSE;
+		}
+		
+		/*Other entries may still point into an empty page, it is
+		  deleted once all entries are visited*/
+		vm_page = MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+		if(mm_is_vm_page_empty(vm_page)){
+			glthread_add_next(&empty_pages, MM_FREE_BLOCK_GLUE(block_meta_data));
+			continue;
+		}
+		
+		mm_add_free_block_meta_data_to_free_block_list(
+			vm_page_family, block_meta_data);
+	}
+	
+	while((curr = empty_pages.right)){
+		remove_glthread(curr);
+		mm_vm_page_delete_and_free(
+			MM_GET_PAGE_FROM_META_BLOCK(glthread_to_block_meta_data(curr)));
+	}
+	return bytes_freed;
+}
+
+/*NULL if app_data was not allocated by the memory manager*/
+static inline vm_page_t *
+mm_get_hosting_vm_page(void *app_data){
+	
+	return mm_pagemap_lookup(app_data);
+}
+
+/*Object counters, see mm_get_stats()*/
+
+/*Bytes app_data gives back to its page family when freed*/
+static inline uint32_t
+mm_freed_size(vm_page_t *hosting_page, void *app_data){
+	
+	if(hosting_page->page_type == MM_VM_PAGE_SLAB)
+		return hosting_page->slab_meta_data.slot_size;
+	/*app_data may point anywhere into a large region*/
+	if(hosting_page->page_type == MM_VM_PAGE_LARGE)
+		return hosting_page->block_meta_data.block_size;
+	return ((block_meta_data_t *)app_data - 1)->block_size;
+}
+
+/*Bytes handed out for a request of req_size bytes aligned to align
+  served at app_data*/
+static inline uint32_t
+mm_allocated_size(vm_page_family_t *vm_page_family, uint32_t req_size,
+				  uint32_t align, void *app_data){
+	
+	if((vm_page_family->flags & MM_FAMILY_SLAB) &&
+			req_size <= vm_page_family->struct_size &&
+			align <= vm_page_family->object_align){
+		return mm_family_slot_size(vm_page_family->struct_size,
+					vm_page_family->flags);
+	}
+	/*Data aligned inside a dedicated region is not behind its meta block*/
+	if(align > vm_page_family->object_align)
+		return mm_freed_size(mm_get_hosting_vm_page(app_data), app_data);
+	return ((block_meta_data_t *)app_data - 1)->block_size;
+}
+
+#ifdef MM_THREAD_SAFE
+
+/*Fold delta into counters other threads may update*/
+static void
+mm_object_counters_add(mm_object_counters_t *counters,
+					   mm_object_counters_t *delta){
+	
+	__atomic_fetch_add(&counters->allocations, delta->allocations,
+			__ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->frees, delta->frees, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->bytes_allocated, delta->bytes_allocated,
+			__ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->remote_allocations, delta->remote_allocations,
+			__ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->remote_frees, delta->remote_frees,
+			__ATOMIC_RELAXED);
+}
+
+/*Remote frees : a thread that finds the family lock busy never waits for
+  it, it pushes the objects on remote_free_head with a single CAS. The
+  next thread to take the lock, typically to allocate, pops the whole
+  stack at once and returns the objects through mm_family_free() so they
+  are coalesced in one batch. Popping everything at once keeps the stack
+  free of ABA problems*/
+static void
+mm_family_remote_free_push(vm_page_family_t *vm_page_family,
+						   void *first, void *last){
+	
+	void *head = __atomic_load_n(&vm_page_family->remote_free_head,
+						__ATOMIC_RELAXED);
+	do{
+		*(void **)last = head;
+	} while(!__atomic_compare_exchange_n(&vm_page_family->remote_free_head,
+				&head, first, MM_TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*The caller holds the family lock*/
+static void
+mm_family_remote_free_drain(vm_page_family_t *vm_page_family){
+	
+	void *app_data, *next;
+	
+	if(!__atomic_load_n(&vm_page_family->remote_free_head, __ATOMIC_RELAXED))
+		return;
+	
+	app_data = __atomic_exchange_n(&vm_page_family->remote_free_head,
+						NULL, __ATOMIC_ACQUIRE);
+	
+	for( ; app_data; app_data = next){
+		next = *(void **)app_data;
+		mm_family_free(mm_get_hosting_vm_page(app_data), app_data);
+	}
+}
+
+static __thread mm_thread_cache_t mm_thread_cache;
+static pthread_key_t mm_thread_cache_key;
+static pthread_once_t mm_thread_cache_key_once = PTHREAD_ONCE_INIT;
+
+static void
+mm_thread_cache_destroy(void *arg);
+
+static void
+mm_thread_cache_key_create(){
+	
+	pthread_key_create(&mm_thread_cache_key, mm_thread_cache_destroy);
+}
+
+static uint32_t
+mm_thread_cache_table_pages(uint32_t n_magazines){
+	
+	return (uint32_t)((n_magazines * sizeof(mm_magazine_t *) +
+				SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+}
+
+/*Slow path : first use of a page family by the calling thread*/
+static mm_magazine_t *
+mm_thread_cache_new_magazine(vm_page_family_t *vm_page_family){
+	
+	mm_thread_cache_t *thread_cache = &mm_thread_cache;
+	uint32_t family_id = vm_page_family->family_id;
+	mm_magazine_t **new_magazines;
+	mm_magazine_t *magazine;
+	uint32_t n_magazines;
+	void *magazine_page;
+	
+	if(!thread_cache->magazines){
+		/*Registers the destructor which flushes the cache on thread exit*/
+		pthread_once(&mm_thread_cache_key_once, mm_thread_cache_key_create);
+		pthread_setspecific(mm_thread_cache_key, thread_cache);
+	}
+	
+	if(family_id >= thread_cache->n_magazines){
+		
+		n_magazines = thread_cache->n_magazines ? thread_cache->n_magazines :
+					(uint32_t)(SYSTEM_PAGE_SIZE / sizeof(mm_magazine_t *));
+		while(n_magazines <= family_id)
+			n_magazines *= 2;
+		
+		new_magazines = mm_get_new_vm_page_from_kernel(
+				mm_thread_cache_table_pages(n_magazines));
+		if(!new_magazines)
+			return NULL;
+		
+		if(thread_cache->magazines){
+			memcpy(new_magazines, thread_cache->magazines,
+				thread_cache->n_magazines * sizeof(mm_magazine_t *));
+			mm_return_vm_page_to_kernel(thread_cache->magazines,
+				mm_thread_cache_table_pages(thread_cache->n_magazines));
+		}
+		
+		thread_cache->magazines = new_magazines;
+		thread_cache->n_magazines = n_magazines;
+	}
+	
+	if(thread_cache->magazine_pool_free < sizeof(mm_magazine_t)){
+		
+		magazine_page = mm_get_new_vm_page_from_kernel(1);
+		if(!magazine_page)
+			return NULL;
+		
+		/*First word of a magazine page links the pages of the thread*/
+		*(void **)magazine_page = thread_cache->magazine_pages;
+		thread_cache->magazine_pages = magazine_page;
+		thread_cache->magazine_pool = (char *)magazine_page + sizeof(void *);
+		thread_cache->magazine_pool_free = SYSTEM_PAGE_SIZE - sizeof(void *);
+	}
+	
+	magazine = (mm_magazine_t *)thread_cache->magazine_pool;
+	thread_cache->magazine_pool += sizeof(mm_magazine_t);
+	thread_cache->magazine_pool_free -= sizeof(mm_magazine_t);
+	
+	magazine->vm_page_family = vm_page_family;
+	magazine->count = 0;
+	memset(&magazine->counters, 0, sizeof(mm_object_counters_t));
+	thread_cache->magazines[family_id] = magazine;
+	
+	/*mm_get_stats() sums the counters of every magazine of the family*/
+	MM_LOCK(&vm_page_family->family_lock);
+	magazine->next = vm_page_family->magazines;
+	vm_page_family->magazines = magazine;
+	MM_UNLOCK(&vm_page_family->family_lock);
+	return magazine;
+}
+
+static inline mm_magazine_t *
+mm_thread_cache_get_magazine(vm_page_family_t *vm_page_family){
+	
+	uint32_t family_id = vm_page_family->family_id;
+	
+	if(family_id < mm_thread_cache.n_magazines &&
+			mm_thread_cache.magazines[family_id]){
+		return mm_thread_cache.magazines[family_id];
+	}
+	return mm_thread_cache_new_magazine(vm_page_family);
+}
+
+static void
+mm_magazine_refill(mm_magazine_t *magazine){
+	
+	vm_page_family_t *vm_page_family = magazine->vm_page_family;
+	void *app_data;
+	vm_bool_t known_zero;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	mm_family_remote_free_drain(vm_page_family);
+	
+	while(magazine->count < MM_MAGAZINE_BATCH){
+		app_data = mm_family_allocate(vm_page_family,
+					vm_page_family->struct_size, vm_page_family->object_align,
+					&known_zero);
+		if(!app_data)
+			break;
+		if(known_zero)
+			app_data = (char *)app_data + MM_MAGAZINE_KNOWN_ZERO;
+		magazine->objects[magazine->count++] = app_data;
+	}
+	
+	mm_family_unlock(vm_page_family);
+}
+
+/*Return n_objects of the magazine to the family. Unless may_block is
+  set a busy family lock hands the objects to the remote free stack*/
+static void
+mm_magazine_drain(mm_magazine_t *magazine, uint32_t n_objects,
+				  vm_bool_t may_block){
+	
+	vm_page_family_t *vm_page_family = magazine->vm_page_family;
+	void *app_data, *first = NULL, *last = NULL;
+	
+	if(n_objects > magazine->count)
+		n_objects = magazine->count;
+	
+	if(!n_objects)
+		return;
+	
+	if(!may_block && !MM_TRYLOCK(&vm_page_family->family_lock)){
+		
+		/*Chain the objects and push them with one CAS*/
+		while(n_objects--){
+			app_data = MM_MAGAZINE_OBJECT(magazine->objects[--magazine->count]);
+			if(!last)
+				last = app_data;
+			*(void **)app_data = first;
+			first = app_data;
+		}
+		mm_family_remote_free_push(vm_page_family, first, last);
+		return;
+	}
+	
+	if(may_block)
+		MM_LOCK(&vm_page_family->family_lock);
+	
+	while(n_objects--){
+		app_data = MM_MAGAZINE_OBJECT(magazine->objects[--magazine->count]);
+		mm_family_free(mm_get_hosting_vm_page(app_data), app_data);
+	}
+	mm_family_remote_free_drain(vm_page_family);
+	
+	mm_family_unlock(vm_page_family);
+}
+
+static void *
+mm_thread_cache_allocate(vm_page_family_t *vm_page_family, vm_bool_t *known_zero){
+	
+	mm_magazine_t *magazine = mm_thread_cache_get_magazine(vm_page_family);
+	void *app_data;
+	
+	if(!magazine)
+		return NULL;
+	
+	if(!magazine->count)
+		mm_magazine_refill(magazine);
+	
+	if(!magazine->count)
+		return NULL;
+	
+	app_data = magazine->objects[--magazine->count];
+	*known_zero = ((uintptr_t)app_data & MM_MAGAZINE_KNOWN_ZERO) ?
+					MM_TRUE : MM_FALSE;
+	return MM_MAGAZINE_OBJECT(app_data);
+}
+
+static vm_bool_t
+mm_thread_cache_free(vm_page_family_t *vm_page_family, void *app_data){
+	
+	mm_magazine_t *magazine = mm_thread_cache_get_magazine(vm_page_family);
+	
+	if(!magazine)
+		return MM_FALSE;
+	
+	if(magazine->count == MM_MAGAZINE_SIZE)
+		mm_magazine_drain(magazine, MM_MAGAZINE_BATCH, MM_FALSE);
+	
+	magazine->objects[magazine->count++] = app_data;
+	return MM_TRUE;
+}
+
+/*Only single objects of the family are cached, data blocks of multi unit
+  requests always go back to the family*/
+static inline vm_bool_t
+mm_is_single_object(vm_page_t *hosting_page, void *app_data){
+	
+	if(hosting_page->page_type == MM_VM_PAGE_SLAB)
+		return MM_TRUE;
+	
+	/*Single objects of slab families all live in slab pages*/
+	if(hosting_page->page_type == MM_VM_PAGE_LARGE ||
+		(hosting_page->page_family->flags & MM_FAMILY_SLAB))
+		return MM_FALSE;
+	
+	block_meta_data_t *block_meta_data = 
+		(block_meta_data_t *)((char *)app_data - sizeof(block_meta_data_t));
+	
+	return block_meta_data->block_size ==
+		mm_family_block_size(hosting_page->page_family,
+			hosting_page->page_family->struct_size) ? MM_TRUE : MM_FALSE;
+}
+
+static void
+mm_thread_cache_destroy(void *arg){
+	
+	mm_thread_cache_t *thread_cache = (mm_thread_cache_t *)arg;
+	vm_page_family_t *vm_page_family;
+	mm_magazine_t *magazine, **link;
+	uint32_t family_id;
+	void *magazine_page;
+	
+	mm_thread_cache_flush();
+	
+	/*The family keeps the counts of the thread*/
+	for(family_id = 0; family_id < thread_cache->n_magazines; family_id++){
+		
+		magazine = thread_cache->magazines[family_id];
+		if(!magazine)
+			continue;
+		
+		vm_page_family = magazine->vm_page_family;
+		MM_LOCK(&vm_page_family->family_lock);
+		for(link = &vm_page_family->magazines; *link != magazine;
+			link = &(*link)->next);
+		*link = magazine->next;
+		mm_object_counters_add(&vm_page_family->object_counters,
+			&magazine->counters);
+		MM_UNLOCK(&vm_page_family->family_lock);
+	}
+	
+	while((magazine_page = thread_cache->magazine_pages)){
+		thread_cache->magazine_pages = *(void **)magazine_page;
+		mm_return_vm_page_to_kernel(magazine_page, 1);
+	}
+	
+	if(thread_cache->magazines){
+		mm_return_vm_page_to_kernel(thread_cache->magazines,
+			mm_thread_cache_table_pages(thread_cache->n_magazines));
+	}
+	
+	memset(thread_cache, 0, sizeof(mm_thread_cache_t));
+}
+
+void
+mm_thread_cache_flush(){
+	
+	uint32_t family_id;
+	mm_magazine_t *magazine;
+	
+	for(family_id = 0; family_id < mm_thread_cache.n_magazines; family_id++){
+		magazine = mm_thread_cache.magazines[family_id];
+		if(magazine && magazine->count)
+			mm_magazine_drain(magazine, magazine->count, MM_TRUE);
+	}
+}
+
+#else
+
+void
+mm_thread_cache_flush(){
+}
+
+#endif /*MM_THREAD_SAFE*/
+
+/*Count objects allocated or freed by the calling thread, which must not
+  hold the family lock*/
+static void
+mm_count_objects(vm_page_family_t *vm_page_family,
+				 uint32_t allocations, uint64_t bytes_allocated,
+				 uint32_t frees, uint64_t bytes_freed){
+	
+#ifdef MM_THREAD_SAFE
+	mm_object_counters_t delta;
+	mm_magazine_t *magazine = mm_thread_cache_get_magazine(vm_page_family);
+	
+	/*Single writer, the stores only have to be seen whole*/
+	if(magazine){
+		mm_object_counters_t *counters = &magazine->counters;
+		__atomic_store_n(&counters->allocations,
+			counters->allocations + allocations, __ATOMIC_RELAXED);
+		__atomic_store_n(&counters->frees,
+			counters->frees + frees, __ATOMIC_RELAXED);
+		__atomic_store_n(&counters->bytes_allocated,
+			counters->bytes_allocated + bytes_allocated - bytes_freed,
+			__ATOMIC_RELAXED);
+		return;
+	}
+	
+	memset(&delta, 0, sizeof(delta));
+	delta.allocations = allocations;
+	delta.frees = frees;
+	delta.bytes_allocated = bytes_allocated - bytes_freed;
+	mm_object_counters_add(&vm_page_family->object_counters, &delta);
+#else
+	vm_page_family->object_counters.allocations += allocations;
+	vm_page_family->object_counters.frees += frees;
+	vm_page_family->object_counters.bytes_allocated +=
+		bytes_allocated - bytes_freed;
+#endif
+}
+
+/*Count objects allocated or freed by a thread of another NUMA node than
+  the pages of the family, like mm_count_objects()*/
+static void
+mm_count_remote_objects(vm_page_family_t *vm_page_family,
+						uint32_t allocations, uint32_t frees){
+	
+#ifdef MM_THREAD_SAFE
+	mm_object_counters_t delta;
+	mm_magazine_t *magazine = mm_thread_cache_get_magazine(vm_page_family);
+	
+	if(magazine){
+		mm_object_counters_t *counters = &magazine->counters;
+		__atomic_store_n(&counters->remote_allocations,
+			counters->remote_allocations + allocations, __ATOMIC_RELAXED);
+		__atomic_store_n(&counters->remote_frees,
+			counters->remote_frees + frees, __ATOMIC_RELAXED);
+		return;
+	}
+	
+	memset(&delta, 0, sizeof(delta));
+	delta.remote_allocations = allocations;
+	delta.remote_frees = frees;
+	mm_object_counters_add(&vm_page_family->object_counters, &delta);
+#else
+	vm_page_family->object_counters.remote_allocations += allocations;
+	vm_page_family->object_counters.remote_frees += frees;
+#endif
+}
+
+/*Frees of objects of a family bound to a node, by the calling thread*/
+static inline void
+mm_numa_count_frees(vm_page_family_t *vm_page_family, uint32_t frees){
+	
+	if(vm_page_family->numa_node >= 0 &&
+		mm_numa_current_node() != vm_page_family->numa_node){
+		mm_count_remote_objects(vm_page_family, 0, frees);
+	}
+}
+
+/*Family of a MM_FAMILY_NUMA_LOCAL family serving the node of the calling
+  thread, other families serve themselves. remote is set when the pages
+  come from another node*/
+static inline vm_page_family_t *
+mm_numa_local_family(vm_page_family_t *vm_page_family, vm_bool_t *remote){
+	
+	int node;
+	
+	*remote = MM_FALSE;
+	
+	if(vm_page_family->numa_node < 0)
+		return vm_page_family;
+	
+	node = mm_numa_current_node();
+	if(node >= 0 && node < MM_NUMA_MAX_NODES &&
+		vm_page_family->node_families[node]){
+		return vm_page_family->node_families[node];
+	}
+	
+	*remote = node != vm_page_family->numa_node ? MM_TRUE : MM_FALSE;
+	return vm_page_family;
+}
+
+#ifdef MM_HEAP_PROFILE
+/*Heap profiler : the bytes allocated by a thread form a stream, sampled
+  at points set apart by exponentially distributed gaps of mean rate,
+  a Poisson process. An allocation holding n points is sampled as n * rate
+  bytes, an unbiased estimate of its size. Samples are hashed by address
+  and counted in their VM data page, frees from pages without samples do
+  not look them up*/
+#define MM_HEAP_PROFILE_BUCKETS_LOG2	12
+#define MM_HEAP_PROFILE_BUCKETS			(1 << MM_HEAP_PROFILE_BUCKETS_LOG2)
+/*While sampling is stopped, threads read the rate again after this*/
+#define MM_HEAP_PROFILE_RECHECK			(1 << 20)
+
+static uint64_t mm_heap_profile_rate = MM_HEAP_PROFILE_DEFAULT_RATE;
+static mm_heap_sample_t *heap_samples[MM_HEAP_PROFILE_BUCKETS];
+static mm_heap_sample_t *free_heap_samples = NULL;
+/*The profiler is busy while it allocates itself, in backtrace() or
+  stdio, those allocations are not sampled*/
+#ifdef MM_THREAD_SAFE
+static __thread int64_t mm_heap_profile_countdown;
+static __thread uint64_t mm_heap_profile_random;
+static __thread vm_bool_t mm_heap_profile_busy;
+static pthread_mutex_t heap_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+static int64_t mm_heap_profile_countdown;
+static uint64_t mm_heap_profile_random;
+static vm_bool_t mm_heap_profile_busy;
+#endif
+
+/*Objects of dedicated regions may be freed through interior pointers,
+  their samples are keyed by the start of the region data*/
+static inline void *
+mm_heap_profile_key(vm_page_t *hosting_page, void *app_data){
+	
+	if(hosting_page->page_type == MM_VM_PAGE_LARGE)
+		return &hosting_page->block_meta_data + 1;
+	return app_data;
+}
+
+static inline uint32_t
+mm_heap_profile_bucket(void *app_data){
+	
+	return (uint32_t)(((uintptr_t)app_data * 0x9E3779B97F4A7C15ull) >>
+				(64 - MM_HEAP_PROFILE_BUCKETS_LOG2));
+}
+
+/*Gap to the next sampled byte, -ln(u) * rate for u uniform in (0, 1].
+  log2(u) is taken from the bits of u, linear between powers of 2, close
+  enough for sampling and it needs no libm*/
+static int64_t
+mm_heap_profile_gap(uint64_t rate){
+	
+	uint64_t x = mm_heap_profile_random;
+	uint32_t msb;
+	double log2_u;
+	
+	/*Seeded differently in every thread*/
+	if(!x)
+		x = ((uintptr_t)&mm_heap_profile_random * 0x9E3779B97F4A7C15ull) | 1;
+	
+	/*xorshift64*/
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	mm_heap_profile_random = x;
+	
+	x = (x >> 11) + 1;	/*1 to 2^53*/
+	msb = 63 - __builtin_clzll(x);
+	log2_u = msb + ((double)x / (double)(1ull << msb) - 1.0) - 53;
+	
+	return (int64_t)(-log2_u * 0.6931471805599453 * rate) + 1;
+}
+
+/*The countdown of the thread went negative*/
+static void __attribute__((noinline))
+mm_heap_profile_sample(vm_page_family_t *vm_page_family, void *app_data,
+					   uint32_t size){
+	
+	uint64_t rate = __atomic_load_n(&mm_heap_profile_rate, __ATOMIC_RELAXED);
+	vm_page_t *hosting_page;
+	mm_heap_sample_t *sample;
+	uint64_t n_points = 0;
+	void *frames[MM_HEAP_PROFILE_MAX_FRAMES + 1];
+	uint32_t bucket, i;
+	int n_frames;
+	
+	/*MM_HEAP_PROFILE_ALLOC() already charged size to the countdown*/
+	(void)size;
+	
+	if(!rate){
+		mm_heap_profile_countdown = MM_HEAP_PROFILE_RECHECK;
+		return;
+	}
+	
+	/*First allocation of the thread, the countdown starts at the first gap*/
+	if(!mm_heap_profile_random)
+		mm_heap_profile_countdown += mm_heap_profile_gap(rate);
+	
+	while(mm_heap_profile_countdown < 0){
+		mm_heap_profile_countdown += mm_heap_profile_gap(rate);
+		n_points++;
+	}
+	
+	if(!n_points || mm_heap_profile_busy)
+		return;
+	
+	mm_heap_profile_busy = MM_TRUE;
+	
+	/*Without the frame of this function*/
+	n_frames = backtrace(frames, MM_HEAP_PROFILE_MAX_FRAMES + 1) - 1;
+	
+	MM_LOCK(&heap_profile_lock);
+	
+	if(!free_heap_samples){
+		free_heap_samples = mm_get_new_vm_page_from_kernel(1);
+		if(!free_heap_samples){
+			MM_UNLOCK(&heap_profile_lock);
+			mm_heap_profile_busy = MM_FALSE;
+			return;
+		}
+		for(i = 0; i + 1 < SYSTEM_PAGE_SIZE / sizeof(mm_heap_sample_t); i++)
+			free_heap_samples[i].next = &free_heap_samples[i + 1];
+		free_heap_samples[i].next = NULL;
+	}
+	
+	sample = free_heap_samples;
+	free_heap_samples = sample->next;
+	
+	hosting_page = mm_get_hosting_vm_page(app_data);
+	app_data = mm_heap_profile_key(hosting_page, app_data);
+	sample->app_data = app_data;
+	sample->vm_page_family = vm_page_family;
+	sample->bytes = n_points * rate;
+	sample->n_frames = n_frames > 0 ? n_frames : 0;
+	for(i = 0; i < sample->n_frames; i++)
+		sample->frames[i] = frames[i + 1];
+	
+	bucket = mm_heap_profile_bucket(app_data);
+	sample->next = heap_samples[bucket];
+	heap_samples[bucket] = sample;
+	
+	__atomic_store_n(&hosting_page->n_sampled, hosting_page->n_sampled + 1,
+		__ATOMIC_RELAXED);
+	
+	MM_UNLOCK(&heap_profile_lock);
+	mm_heap_profile_busy = MM_FALSE;
+}
+
+/*Unlink the sample of app_data, NULL when it was not sampled. Caller
+  holds heap_profile_lock*/
+static mm_heap_sample_t *
+mm_heap_profile_unlink(void *app_data){
+	
+	mm_heap_sample_t **link, *sample;
+	
+	for(link = &heap_samples[mm_heap_profile_bucket(app_data)];
+		(sample = *link); link = &sample->next){
+		
+		if(sample->app_data == app_data){
+			*link = sample->next;
+			return sample;
+		}
+	}
+	return NULL;
+}
+
+/*app_data of a page holding samples is freed*/
+static void
+mm_heap_profile_forget(vm_page_t *hosting_page, void *app_data){
+	
+	mm_heap_sample_t *sample;
+	
+	MM_LOCK(&heap_profile_lock);
+	sample = mm_heap_profile_unlink(mm_heap_profile_key(hosting_page, app_data));
+	if(sample){
+		__atomic_store_n(&hosting_page->n_sampled, hosting_page->n_sampled - 1,
+			__ATOMIC_RELAXED);
+		sample->next = free_heap_samples;
+		free_heap_samples = sample;
+	}
+	MM_UNLOCK(&heap_profile_lock);
+}
+
+/*mm_compact() moved an object out of a page holding samples*/
+static void
+mm_heap_profile_move(vm_page_t *hosting_page, void *old_address,
+					 void *new_address){
+	
+	mm_heap_sample_t *sample;
+	vm_page_t *new_page = mm_get_hosting_vm_page(new_address);
+	uint32_t bucket;
+	
+	MM_LOCK(&heap_profile_lock);
+	sample = mm_heap_profile_unlink(old_address);
+	if(sample){
+		sample->app_data = new_address;
+		bucket = mm_heap_profile_bucket(new_address);
+		sample->next = heap_samples[bucket];
+		heap_samples[bucket] = sample;
+		__atomic_store_n(&hosting_page->n_sampled, hosting_page->n_sampled - 1,
+			__ATOMIC_RELAXED);
+		__atomic_store_n(&new_page->n_sampled, new_page->n_sampled + 1,
+			__ATOMIC_RELAXED);
+	}
+	MM_UNLOCK(&heap_profile_lock);
+}
+
+/*Order samples by family then stack, so equal sites are adjacent*/
+static int
+mm_heap_sample_compare(const void *a, const void *b){
+	
+	const mm_heap_sample_t *first = a, *second = b;
+	uint32_t i;
+	
+	if(first->vm_page_family != second->vm_page_family)
+		return first->vm_page_family < second->vm_page_family ? -1 : 1;
+	if(first->n_frames != second->n_frames)
+		return first->n_frames < second->n_frames ? -1 : 1;
+	for(i = 0; i < first->n_frames; i++){
+		if(first->frames[i] != second->frames[i])
+			return first->frames[i] < second->frames[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+static void
+mm_heap_profile_print_frame(FILE *file, void *frame){
+	
+	Dl_info info;
+	const char *module;
+	
+	if(dladdr(frame, &info) && info.dli_sname){
+		fprintf(file, ";%s+0x%lx", info.dli_sname,
+			(unsigned long)((char *)frame - (char *)info.dli_saddr));
+		return;
+	}
+	
+	if(info.dli_fname){
+		module = strrchr(info.dli_fname, '/');
+		fprintf(file, ";%s+0x%lx", module ? module + 1 : info.dli_fname,
+			(unsigned long)((char *)frame - (char *)info.dli_fbase));
+		return;
+	}
+	
+	fprintf(file, ";0x%lx", (unsigned long)frame);
+}
+#endif /*MM_HEAP_PROFILE*/
+
+void
+mm_set_heap_profile_rate(uint64_t rate){
+	
+#ifdef MM_HEAP_PROFILE
+	__atomic_store_n(&mm_heap_profile_rate, rate, __ATOMIC_RELAXED);
+#else
+	(void)rate;
+#endif
+}
+
+int
+mm_dump_heap_profile(const char *path){
+	
+#ifdef MM_HEAP_PROFILE
+	mm_heap_sample_t *samples = NULL, *sample;
+	uint32_t n_samples = 0, units = 0, bucket, i, j;
+	uint64_t bytes;
+	FILE *file;
+	int rc = 0;
+	
+	mm_heap_profile_busy = MM_TRUE;
+	
+	/*Copy the samples out, the lock is not held while writing*/
+	MM_LOCK(&heap_profile_lock);
+	for(bucket = 0; bucket < MM_HEAP_PROFILE_BUCKETS; bucket++){
+		for(sample = heap_samples[bucket]; sample; sample = sample->next)
+			n_samples++;
+	}
+	
+	if(n_samples){
+		units = (uint32_t)((n_samples * sizeof(mm_heap_sample_t) +
+					SYSTEM_PAGE_SIZE - 1) >> SYSTEM_PAGE_SHIFT);
+		samples = mm_get_new_vm_page_from_kernel(units);
+	}
+	
+	if(samples){
+		i = 0;
+		for(bucket = 0; bucket < MM_HEAP_PROFILE_BUCKETS; bucket++){
+			for(sample = heap_samples[bucket]; sample; sample = sample->next)
+				samples[i++] = *sample;
+		}
+	}
+	MM_UNLOCK(&heap_profile_lock);
+	
+	if(n_samples && !samples){
+		mm_heap_profile_busy = MM_FALSE;
+		return -1;
+	}
+	
+	file = path ? fopen(path, "w") : stdout;
+	if(!file){
+		printf("Error : %s() Could not open %s\n", __FUNCTION__, path);
+		rc = -1;
+		goto done;
+	}
+	
+	if(n_samples)
+		qsort(samples, n_samples, sizeof(mm_heap_sample_t), mm_heap_sample_compare);
+	
+	for(i = 0; i < n_samples; i = j){
+		
+		bytes = 0;
+		for(j = i; j < n_samples &&
+				!mm_heap_sample_compare(&samples[i], &samples[j]); j++){
+			bytes += samples[j].bytes;
+		}
+		
+		fprintf(file, "%s", samples[i].vm_page_family->struct_name);
+		for(bucket = samples[i].n_frames; bucket > 0; bucket--)
+			mm_heap_profile_print_frame(file, samples[i].frames[bucket - 1]);
+		fprintf(file, " %lu\n", (unsigned long)bytes);
+	}
+	
+	if(path && fclose(file))
+		rc = -1;
+	else if(!path)
+		fflush(file);
+	
+done:
+	if(samples)
+		mm_return_vm_page_to_kernel(samples, units);
+	mm_heap_profile_busy = MM_FALSE;
+	return rc;
+#else
+	(void)path;
+	printf("Error : %s() Memory Manager was built without MM_HEAP_PROFILE\n",
+		__FUNCTION__);
+	return -1;
+#endif
+}
+
+/*Allocation from a resolved page family, no lookup by name is done here.
+  The data is aligned to align or to the family alignment if stricter.
+  Memory known to hold zeros already is not cleared again*/
+static void *
+mm_allocate_bytes(vm_page_family_t *pg_family, uint32_t req_size,
+				  uint32_t align, vm_bool_t zero){
+	
+	void *app_data = NULL;
+	vm_bool_t known_zero = MM_FALSE;
+	vm_bool_t remote;
+	MM_LATENCY_START(start);
+	
+	if(!pg_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return NULL;
+	}
+	
+	pg_family = mm_numa_local_family(pg_family, &remote);
+	
+	if(align < pg_family->object_align)
+		align = pg_family->object_align;
+	
+#ifdef MM_THREAD_SAFE
+	/*Common case, served from the magazine of the calling thread.
+	  Objects of dedicated regions are not worth caching, those of
+	  relocatable families must all be known to mm_compact()*/
+	if(req_size <= pg_family->struct_size && !pg_family->relocate &&
+		align == pg_family->object_align &&
+		mm_family_block_size(pg_family, pg_family->struct_size) <=
+			pg_family->large_threshold &&
+		mm_family_block_size(pg_family, pg_family->struct_size) <=
+			mm_max_page_allocatable_memory(pg_family->span_units)){
+		app_data = mm_thread_cache_allocate(pg_family, &known_zero);
+	}
+#endif
+	
+	if(!app_data){
+		MM_LOCK(&pg_family->family_lock);
+#ifdef MM_THREAD_SAFE
+		mm_family_remote_free_drain(pg_family);
+#endif
+		app_data = mm_family_allocate(pg_family, req_size, align, &known_zero);
+		mm_family_unlock(pg_family);
+	}
+	
+	if(!app_data)
+		return NULL;
+	
+	mm_count_objects(pg_family, 1,
+		mm_allocated_size(pg_family, req_size, align, app_data), 0, 0);
+	if(remote)
+		mm_count_remote_objects(pg_family, 1, 0);
+	MM_HEAP_PROFILE_ALLOC(pg_family, app_data, req_size);
+	
+	if(zero && !known_zero)
+		memset(app_data, 0, req_size);
+	
+	MM_LATENCY_END(pg_family, MM_LATENCY_ALLOC, start);
+	return app_data;
+}
+
+void *
+xcalloc_family_bytes(vm_page_family_t *pg_family, uint32_t req_size){
+	
+	return mm_allocate_bytes(pg_family, req_size, MM_ALIGNMENT, MM_TRUE);
+}
+
+void *
+xmalloc_family_bytes(vm_page_family_t *pg_family, uint32_t req_size){
+	
+	return mm_allocate_bytes(pg_family, req_size, MM_ALIGNMENT, MM_FALSE);
+}
+
+void *
+xcalloc_family(vm_page_family_t *pg_family, int units){
+	
+	if(!pg_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return NULL;
+	}
+	
+	return mm_allocate_bytes(pg_family, units * pg_family->struct_size,
+				MM_ALIGNMENT, MM_TRUE);
+}
+
+void *
+xmalloc_family(vm_page_family_t *pg_family, int units){
+	
+	if(!pg_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return NULL;
+	}
+	
+	return mm_allocate_bytes(pg_family, units * pg_family->struct_size,
+				MM_ALIGNMENT, MM_FALSE);
+}
+
+/*The public function to be invoked by the application for Dynamic Memory Allocation*/
+void * 
+xcalloc(char *struct_name, int units){
+
+	/*Step 1*/
+	vm_page_family_t *pg_family = 
+			lookup_page_family_by_name(struct_name);
+	
+	if(!pg_family){
+		printf("Error : Structure %s is not registered with Memory Manager\n",
+																	struct_name);
+		return NULL;
+	}
+	
+	return mm_allocate_bytes(pg_family, units * pg_family->struct_size,
+				MM_ALIGNMENT, MM_TRUE);
+	
+}
+
+void *
+xmalloc(char *struct_name, int units){
+	
+	vm_page_family_t *pg_family = 
+			lookup_page_family_by_name(struct_name);
+	
+	if(!pg_family){
+		printf("Error : Structure %s is not registered with Memory Manager\n",
+																	struct_name);
+		return NULL;
+	}
+	
+	return mm_allocate_bytes(pg_family, units * pg_family->struct_size,
+				MM_ALIGNMENT, MM_FALSE);
+}
+
+
+void *
+xcalloc_aligned(vm_page_family_t *pg_family, int units, uint32_t align){
+	
+	if(!pg_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return NULL;
+	}
+	
+	if(!align || (align & (align - 1))){
+		printf("Error : %s() Alignment %u is not a power of 2\n",
+			__FUNCTION__, align);
+		return NULL;
+	}
+	
+	return mm_allocate_bytes(pg_family, units * pg_family->struct_size,
+				align, MM_TRUE);
+}
 
+int
+xcalloc_bulk(vm_page_family_t *pg_family, int n, void **out){
+	
+	uint32_t count, i;
+	uint64_t bytes_allocated = 0;
+	vm_bool_t remote;
+	
+	if(!pg_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return 0;
+	}
+	
+	if(n <= 0)
+		return 0;
+	
+	pg_family = mm_numa_local_family(pg_family, &remote);
+	
+	MM_LOCK(&pg_family->family_lock);
+#ifdef MM_THREAD_SAFE
+	mm_family_remote_free_drain(pg_family);
+#endif
+	count = mm_family_allocate_bulk(pg_family, pg_family->struct_size,
+				n, MM_TRUE, out);
+	mm_family_unlock(pg_family);
+	
+	for(i = 0; i < count; i++){
+		bytes_allocated += mm_allocated_size(pg_family,
+							pg_family->struct_size, pg_family->object_align, out[i]);
+		MM_HEAP_PROFILE_ALLOC(pg_family, out[i], pg_family->struct_size);
+	}
+	mm_count_objects(pg_family, count, bytes_allocated, 0, 0);
+	if(remote)
+		mm_count_remote_objects(pg_family, count, 0);
+	
+	return count;
+}
 
 
 static block_meta_data_t *
 mm_free_blocks(block_meta_data_t *to_be_free_block){
 	
-	block_meta_data_t *return_block = NULL;
+	block_meta_data_t *return_block = NULL;
+	
+	assert(to_be_free_block->is_free == MM_FALSE);
+	
+	vm_page_t *hosting_page = 
+			MM_GET_PAGE_FROM_META_BLOCK(to_be_free_block);
+	
+	vm_page_family_t *vm_page_family = hosting_page->page_family;
+	
+	return_block = to_be_free_block;
+	
+	to_be_free_block->is_free = MM_TRUE;
+	
+	/*Hard internal fragmentation was kept by the allocated block, it
+	  goes back with it*/
+	block_meta_data_t *next_block = NEXT_META_BLOCK(to_be_free_block);
+	
+	/*Now perform Merging, a neighbour leaves its size class list
+	  before its size changes*/
+	if(next_block && next_block->is_free == MM_TRUE){
+		/*Union two free blocks*/
+		mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, next_block);
+		mm_union_free_blocks(to_be_free_block, next_block);
+		return_block = to_be_free_block;
+	}
+	/*Chech the previous block if it was free*/
+	block_meta_data_t *prev_block = PREV_META_BLOCK(to_be_free_block);
+	
+	if(prev_block && prev_block->is_free){
+		mm_remove_free_block_meta_data_from_free_block_list(
+				vm_page_family, prev_block);
+		mm_union_free_blocks(prev_block, to_be_free_block);
+		return_block = prev_block;
+	}
+	
+	if(mm_is_vm_page_empty(hosting_page)){
+		mm_vm_page_delete_and_free(hosting_page);
+		return NULL;
+	}
+	
+	mm_add_free_block_meta_data_to_free_block_list(
+			vm_page_family, return_block);
+	
+	return return_block;
+}
+
+
+void xfree(void *app_data){
+	
+	MM_LATENCY_START(start);
+	vm_page_t *hosting_page = mm_get_hosting_vm_page(app_data);
+	vm_page_family_t *vm_page_family;
+	
+	if(!hosting_page){
+		printf("Error : %s() %p was not allocated by Memory Manager\n",
+			__FUNCTION__, app_data);
+		return;
+	}
+	
+	vm_page_family = hosting_page->page_family;
+	
+	MM_HEAP_PROFILE_FREE(hosting_page, app_data);
+	mm_count_objects(vm_page_family, 0, 0, 1,
+		mm_freed_size(hosting_page, app_data));
+	mm_numa_count_frees(vm_page_family, 1);
+	
+#ifdef MM_THREAD_SAFE
+	if(!vm_page_family->relocate &&
+		mm_is_single_object(hosting_page, app_data) &&
+		mm_thread_cache_free(vm_page_family, app_data)){
+		MM_LATENCY_END(vm_page_family, MM_LATENCY_FREE, start);
+		return;
+	}
+	
+	/*Never wait for the family lock on the free path*/
+	if(!MM_TRYLOCK(&vm_page_family->family_lock)){
+		mm_family_remote_free_push(vm_page_family, app_data, app_data);
+		MM_LATENCY_END(vm_page_family, MM_LATENCY_FREE, start);
+		return;
+	}
+	mm_family_remote_free_drain(vm_page_family);
+#else
+	MM_LOCK(&vm_page_family->family_lock);
+#endif
+	mm_family_free(hosting_page, app_data);
+	mm_family_unlock(vm_page_family);
+	MM_LATENCY_END(vm_page_family, MM_LATENCY_FREE, start);
+} 
+
+size_t
+mm_usable_size(void *app_data){
+	
+	vm_page_t *hosting_page = mm_get_hosting_vm_page(app_data);
+	
+	if(!hosting_page)
+		return 0;
+	
+	if(hosting_page->page_type == MM_VM_PAGE_SLAB)
+		return hosting_page->slab_meta_data.slot_size;
+	
+	if(hosting_page->page_type == MM_VM_PAGE_LARGE){
+		return (char *)(&hosting_page->block_meta_data + 1) +
+				hosting_page->block_meta_data.block_size - (char *)app_data;
+	}
+	
+	return ((block_meta_data_t *)app_data - 1)->block_size;
+}
+
+void *
+xrealloc(void *app_data, int new_units){
+	
+	vm_page_t *hosting_page, *vm_page;
+	vm_page_family_t *vm_page_family;
+	block_meta_data_t *block_meta_data;
+	uint64_t req_size;
+	uint32_t old_size, size, offset, units;
+	size_t usable;
+	vm_bool_t resized;
+	void *new_data;
+	
+	if(!app_data){
+		printf("Error : %s() NULL has no page family, use xcalloc()\n",
+			__FUNCTION__);
+		return NULL;
+	}
+	
+	hosting_page = mm_get_hosting_vm_page(app_data);
+	
+	if(!hosting_page){
+		printf("Error : %s() %p was not allocated by Memory Manager\n",
+			__FUNCTION__, app_data);
+		return NULL;
+	}
+	
+	if(new_units <= 0){
+		xfree(app_data);
+		return NULL;
+	}
+	
+	vm_page_family = hosting_page->page_family;
+	req_size = (uint64_t)new_units * vm_page_family->struct_size;
+	
+	/*Block sizes and region lengths are 32 bit*/
+	if(req_size > UINT32_MAX - 2 * SYSTEM_PAGE_SIZE){
+		printf("Error : %s() %d units of %s exceed the maximum block size\n",
+			__FUNCTION__, new_units, vm_page_family->struct_name);
+		return NULL;
+	}
+	
+	old_size = mm_freed_size(hosting_page, app_data);
+	
+	/*The resized object is sampled anew, as an allocation of its new size*/
+	MM_HEAP_PROFILE_FREE(hosting_page, app_data);
+	
+	switch(hosting_page->page_type){
+		
+		case MM_VM_PAGE_SLAB:
+			if(req_size <= hosting_page->slab_meta_data.slot_size){
+				MM_HEAP_PROFILE_ALLOC(vm_page_family, app_data, (uint32_t)req_size);
+				return app_data;
+			}
+			break;
+		
+		case MM_VM_PAGE_BLOCKS:
+			size = mm_family_block_size(vm_page_family, (uint32_t)req_size);
+			/*Requests past the threshold belong in a dedicated region*/
+			if(size > vm_page_family->large_threshold)
+				break;
+			
+			block_meta_data = (block_meta_data_t *)app_data - 1;
+			MM_LOCK(&vm_page_family->family_lock);
+#ifdef MM_THREAD_SAFE
+			mm_family_remote_free_drain(vm_page_family);
+#endif
+			resized = mm_resize_data_block(vm_page_family, block_meta_data, size);
+			size = block_meta_data->block_size;
+			mm_family_unlock(vm_page_family);
+			
+			if(!resized)
+				break;
+			
+			mm_count_objects(vm_page_family, 0, size, 0, old_size);
+			MM_HEAP_PROFILE_ALLOC(vm_page_family, app_data, (uint32_t)req_size);
+			return app_data;
+		
+		case MM_VM_PAGE_LARGE:
+			/*app_data may point anywhere into the region*/
+			offset = (uint32_t)((char *)app_data -
+						(char *)(&hosting_page->block_meta_data + 1));
+			units = (uint32_t)((offset_of(vm_page_t, page_memory) + offset +
+						req_size + SYSTEM_PAGE_SIZE - 1) >> SYSTEM_PAGE_SHIFT);
+			
+			MM_LOCK(&vm_page_family->family_lock);
+			vm_page = mm_large_page_resize(hosting_page, units);
+			size = vm_page ? vm_page->block_meta_data.block_size : 0;
+			MM_UNLOCK(&vm_page_family->family_lock);
+			
+			if(!vm_page)
+				break;
+			
+			mm_count_objects(vm_page_family, 0, size, 0, old_size);
+			new_data = (char *)(&vm_page->block_meta_data + 1) + offset;
+			MM_HEAP_PROFILE_ALLOC(vm_page_family, new_data, (uint32_t)req_size);
+			return new_data;
+	}
+	
+	/*Last resort, move the object*/
+	new_data = mm_allocate_bytes(vm_page_family, (uint32_t)req_size,
+					MM_ALIGNMENT, MM_FALSE);
+	if(!new_data){
+		MM_HEAP_PROFILE_ALLOC(vm_page_family, app_data, old_size);
+		return NULL;
+	}
+	
+	usable = mm_usable_size(app_data);
+	memcpy(new_data, app_data, usable < req_size ? usable : req_size);
+	xfree(app_data);
+	return new_data;
+}
+
+/*Runs of objects living in data pages of one family are freed together,
+  everything else goes back one object at a time*/
+void
+xfree_bulk(void **ptrs, int n){
+	
+	vm_page_t *hosting_page;
+	vm_page_family_t *vm_page_family, *locked_family = NULL;
+	uint64_t bytes_freed = 0;
+	uint32_t n_freed = 0;
+	char *page_end;
+	int i = 0, j;
+	
+	while(i < n){
+		
+		hosting_page = mm_get_hosting_vm_page(ptrs[i]);
+		
+		if(!hosting_page){
+			printf("Error : %s() %p was not allocated by Memory Manager\n",
+				__FUNCTION__, ptrs[i]);
+			i++;
+			continue;
+		}
+		
+		vm_page_family = hosting_page->page_family;
+		
+		/*Consecutive objects of one family share a lock acquisition*/
+		if(vm_page_family != locked_family){
+			if(locked_family){
+				mm_family_unlock(locked_family);
+				mm_count_objects(locked_family, 0, 0, n_freed, bytes_freed);
+				mm_numa_count_frees(locked_family, n_freed);
+			}
+			n_freed = 0;
+			bytes_freed = 0;
+			locked_family = vm_page_family;
+			MM_LOCK(&locked_family->family_lock);
+#ifdef MM_THREAD_SAFE
+			mm_family_remote_free_drain(locked_family);
+#endif
+		}
+		
+		MM_HEAP_PROFILE_FREE(hosting_page, ptrs[i]);
+		
+		if(hosting_page->page_type != MM_VM_PAGE_BLOCKS){
+			n_freed++;
+			bytes_freed += mm_freed_size(hosting_page, ptrs[i]);
+			mm_family_free(hosting_page, ptrs[i]);
+			i++;
+			continue;
+		}
+		
+		for(j = i + 1; j < n; j++){
+			
+			page_end = (char *)hosting_page +
+					((size_t)hosting_page->page_units << SYSTEM_PAGE_SHIFT);
+			if((char *)ptrs[j] <= (char *)hosting_page || (char *)ptrs[j] >= page_end){
+				
+				hosting_page = mm_get_hosting_vm_page(ptrs[j]);
+				if(!hosting_page || hosting_page->page_family != vm_page_family ||
+					hosting_page->page_type != MM_VM_PAGE_BLOCKS){
+					break;
+				}
+			}
+			
+			MM_HEAP_PROFILE_FREE(hosting_page, ptrs[j]);
+		}
+		
+		n_freed += j - i;
+		bytes_freed += mm_family_free_blocks_bulk(vm_page_family, ptrs + i, j - i);
+		i = j;
+	}
+	
+	if(locked_family){
+		mm_family_unlock(locked_family);
+		mm_count_objects(locked_family, 0, 0, n_freed, bytes_freed);
+		mm_numa_count_frees(locked_family, n_freed);
+	}
+}
+
+/*Arenas, see vm_arena_t. Only the arena list is locked, an arena
+  belongs to one thread at a time*/
+static inline char *
+mm_arena_page_data(vm_arena_t *arena, vm_arena_page_t *arena_page){
+	
+	char *data = (char *)(arena_page + 1);
+	
+	if(arena_page == arena->first_page)
+		data = (char *)(arena + 1);
+	return (char *)MM_ALIGN_UP_TO((uintptr_t)data, MM_ARENA_ALIGNMENT);
+}
+
+static inline char *
+mm_arena_page_end(vm_arena_page_t *arena_page){
+	
+	return (char *)arena_page + (arena_page->units << SYSTEM_PAGE_SHIFT);
+}
+
+static vm_arena_page_t *
+mm_arena_page_new(vm_arena_t *arena, uint64_t units){
+	
+	vm_arena_page_t *arena_page = mm_get_new_vm_page_from_kernel((int)units);
+	
+	if(!arena_page)
+		return NULL;
+	
+	arena_page->next = NULL;
+	arena_page->units = units;
+	__atomic_store_n(&arena->n_units, arena->n_units + units, __ATOMIC_RELAXED);
+	return arena_page;
+}
+
+mm_arena_t
+mm_arena_create(char *name){
+	
+	vm_arena_page_t *arena_page = mm_get_new_vm_page_from_kernel(1);
+	vm_arena_t *arena;
+	
+	if(!arena_page)
+		return NULL;
+	
+	/*The page is zero filled, the name stays terminated*/
+	arena_page->units = 1;
+	arena = (vm_arena_t *)(arena_page + 1);
+	strncpy(arena->name, name, MM_MAX_STRUCT_NAME - 1);
+	arena->first_page = arena_page;
+	arena->n_units = 1;
+	mm_arena_reset(arena);
+	
+	MM_LOCK(&mm_arena_lock);
+	arena->next = arenas;
+	if(arenas)
+		arenas->prev = arena;
+	arenas = arena;
+	MM_UNLOCK(&mm_arena_lock);
+	return arena;
+}
+
+/*The current page cannot hold size bytes*/
+static void *
+mm_arena_alloc_page(vm_arena_t *arena, size_t size){
+	
+	vm_arena_page_t *arena_page;
+	uint64_t units;
+	char *data;
+	
+	if(size > ((size_t)INT32_MAX << SYSTEM_PAGE_SHIFT) - sizeof(vm_arena_page_t)){
+		printf("Error : %s() %zu bytes cannot be allocated\n",
+			__FUNCTION__, size);
+		return NULL;
+	}
+	size = MM_ALIGN_UP_TO(size, (size_t)MM_ARENA_ALIGNMENT);
+	
+	/*A page of its own, until the next reset*/
+	if(size > ((size_t)MM_ARENA_MAX_PAGE_UNITS << SYSTEM_PAGE_SHIFT) / 4){
+		arena_page = mm_arena_page_new(arena, (sizeof(vm_arena_page_t) + size +
+						SYSTEM_PAGE_SIZE - 1) >> SYSTEM_PAGE_SHIFT);
+		if(!arena_page)
+			return NULL;
+		arena_page->next = arena->large_pages;
+		arena->large_pages = arena_page;
+		return mm_arena_page_data(arena, arena_page);
+	}
+	
+	/*Pages kept by the last reset, the rest of a page too small for the
+	  request stays unused until the next reset*/
+	while((arena_page = arena->curr_page->next)){
+		arena->curr_page = arena_page;
+		data = mm_arena_page_data(arena, arena_page);
+		if(size <= (size_t)(mm_arena_page_end(arena_page) - data))
+			goto done;
+	}
+	
+	units = arena->curr_page->units * 2;
+	if(units > MM_ARENA_MAX_PAGE_UNITS)
+		units = MM_ARENA_MAX_PAGE_UNITS;
+	while((units << SYSTEM_PAGE_SHIFT) < sizeof(vm_arena_page_t) + size)
+		units *= 2;
+	
+	arena_page = mm_arena_page_new(arena, units);
+	if(!arena_page)
+		return NULL;
+	arena->curr_page->next = arena_page;
+	arena->curr_page = arena_page;
+	data = mm_arena_page_data(arena, arena_page);
+	
+done:
+	arena->cursor = data + size;
+	arena->end = mm_arena_page_end(arena_page);
+	return data;
+}
+
+void *
+mm_arena_alloc(mm_arena_t arena, size_t size){
+	
+	char *data = arena->cursor;
+	
+	/*Zero bytes still get an object of their own*/
+	if(!size)
+		size = MM_ARENA_ALIGNMENT;
+	
+	/*Rounded up, unless that wraps*/
+	if(size > (size_t)(arena->end - data) ||
+		MM_ALIGN_UP_TO(size, (size_t)MM_ARENA_ALIGNMENT) > (size_t)(arena->end - data)){
+		data = mm_arena_alloc_page(arena, size);
+		if(!data)
+			return NULL;
+	}
+	else{
+		arena->cursor = data + MM_ALIGN_UP_TO(size, (size_t)MM_ARENA_ALIGNMENT);
+	}
+	
+	__atomic_store_n(&arena->bytes_allocated, arena->bytes_allocated + size,
+		__ATOMIC_RELAXED);
+	return data;
+}
+
+void
+mm_arena_reset(mm_arena_t arena){
+	
+	vm_arena_page_t *arena_page;
+	
+	while((arena_page = arena->large_pages)){
+		arena->large_pages = arena_page->next;
+		__atomic_store_n(&arena->n_units, arena->n_units - arena_page->units,
+			__ATOMIC_RELAXED);
+		mm_return_vm_page_to_kernel(arena_page, (int)arena_page->units);
+	}
+	
+	arena->curr_page = arena->first_page;
+	arena->cursor = mm_arena_page_data(arena, arena->first_page);
+	arena->end = mm_arena_page_end(arena->first_page);
+	__atomic_store_n(&arena->bytes_allocated, 0, __ATOMIC_RELAXED);
+}
+
+void
+mm_arena_destroy(mm_arena_t arena){
+	
+	vm_arena_page_t *arena_page, *next;
+	
+	MM_LOCK(&mm_arena_lock);
+	if(arena->prev)
+		arena->prev->next = arena->next;
+	else
+		arenas = arena->next;
+	if(arena->next)
+		arena->next->prev = arena->prev;
+	MM_UNLOCK(&mm_arena_lock);
+	
+	mm_arena_reset(arena);
+	
+	/*The first page holds the arena, it goes last*/
+	for(arena_page = arena->first_page->next; arena_page; arena_page = next){
+		next = arena_page->next;
+		mm_return_vm_page_to_kernel(arena_page, (int)arena_page->units);
+	}
+	mm_return_vm_page_to_kernel(arena->first_page, 1);
+}
+
+/*Compaction, see mm_compact(). The caller holds the family lock in all
+  of the helpers below*/
+static int
+mm_compact_page_compare(const void *a, const void *b){
+	
+	const mm_compact_page_t *first = a, *second = b;
+	
+	return first->live < second->live ? -1 : first->live > second->live;
+}
+
+/*Fill pages with the VM data pages of the given type and what they hold,
+  returns their number*/
+static uint32_t
+mm_compact_collect(vm_page_family_t *vm_page_family, vm_page_type_t page_type,
+				   mm_compact_page_t *pages){
+	
+	vm_page_t *vm_page;
+	block_meta_data_t *curr;
+	uint32_t n_pages = 0;
+	
+	ITERATE_VM_PAGE_BEGIN(vm_page_family, vm_page){
+	
+		if(vm_page->page_type != page_type)
+			continue;
+	
+		pages[n_pages].vm_page = vm_page;
+		pages[n_pages].live = 0;
+		pages[n_pages].free = 0;
+	
+		if(page_type == MM_VM_PAGE_SLAB){
+			pages[n_pages].live = vm_page->slab_meta_data.n_objects -
+									vm_page->slab_meta_data.n_free;
+			pages[n_pages].free = vm_page->slab_meta_data.n_free;
+			n_pages++;
+			continue;
+		}
+	
+		ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page, curr){
+			if(curr->is_free)
+				pages[n_pages].free += curr->block_size;
+			else
+				pages[n_pages].live += sizeof(block_meta_data_t) + curr->block_size;
+		} ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page, curr);
+		n_pages++;
+	
+	} ITERATE_VM_PAGE_END(vm_page_family, vm_page);
+	
+	return n_pages;
+}
+
+/*Sort the sparsest pages first and pick as many as the free space of the
+  other pages can take the live data of. Free space is scattered over
+  blocks of any size, a quarter of it is left as slack. Returns the
+  number of pages picked*/
+static uint32_t
+mm_compact_plan(mm_compact_page_t *pages, uint32_t n_pages){
+	
+	uint64_t total_free = 0, source_live = 0, source_free = 0;
+	uint32_t i;
+	
+	for(i = 0; i < n_pages; i++)
+		total_free += pages[i].free;
+	
+	qsort(pages, n_pages, sizeof(mm_compact_page_t), mm_compact_page_compare);
+	
+	for(i = 0; i < n_pages; i++){
+		source_live += pages[i].live;
+		source_free += pages[i].free;
+		if(source_live * 4 > (total_free - source_free) * 3)
+			break;
+	}
+	return i;
+}
+
+/*Keep the allocator off a page about to be emptied*/
+static void
+mm_compact_detach(vm_page_family_t *vm_page_family, vm_page_t *vm_page){
+	
+	block_meta_data_t *curr;
+	
+	if(vm_page->page_type == MM_VM_PAGE_SLAB){
+		if(vm_page->slab_meta_data.n_free)
+			remove_glthread(&vm_page->slab_meta_data.partial_slab_glue);
+		return;
+	}
+	
+	ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page, curr){
+		if(curr->is_free)
+			mm_remove_free_block_meta_data_from_free_block_list(vm_page_family, curr);
+	} ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page, curr);
+}
+
+/*Give a page which could not be emptied back to the allocator, merging
+  the blocks moved out of it with their free neighbours*/
+static void
+mm_compact_attach(vm_page_family_t *vm_page_family, vm_page_t *vm_page){
+	
+	block_meta_data_t *curr, *next;
+	
+	if(vm_page->page_type == MM_VM_PAGE_SLAB){
+		if(vm_page->slab_meta_data.n_free){
+			glthread_add_next(&vm_page_family->partial_slab_list_head,
+					&vm_page->slab_meta_data.partial_slab_glue);
+		}
+		return;
+	}
+	
+	for(curr = &vm_page->block_meta_data; curr; curr = NEXT_META_BLOCK(curr)){
+	
+		if(!curr->is_free)
+			continue;
+	
+		while((next = NEXT_META_BLOCK(curr)) && next->is_free)
+			mm_union_free_blocks(curr, next);
+		mm_add_free_block_meta_data_to_free_block_list(vm_page_family, curr);
+	}
+}
+
+/*Move the allocated blocks of a detached page into free blocks of the
+  family, best fitting ones first to fill the dense pages. Returns
+  whether the page was emptied, *bytes_grown counts the bytes the moved
+  blocks gained*/
+static vm_bool_t
+mm_compact_block_page(vm_page_family_t *vm_page_family, vm_page_t *vm_page,
+					  uint64_t *bytes_grown){
+	
+	block_meta_data_t *curr, *destination;
+	vm_bool_t emptied = MM_TRUE;
+	uint32_t size;
+	
+	ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page, curr){
+	
+		if(curr->is_free)
+			continue;
 	
-	assert(to_be_free_block->is_free == MM_FALSE);
+		/*The last block of a page holds the page tail, off the family
+		  stride, the free remainder must start aligned all the same*/
+		size = mm_family_block_size(vm_page_family, curr->block_size);
+		destination = mm_find_free_block_page_family(vm_page_family, size);
 	
-	vm_page_t *hosting_page = 
-			MM_GET_PAGE_FROM_META_BLOCK(to_be_free_block);
+		if(!destination || !mm_split_free_data_block_for_allocation(
+				vm_page_family, destination, size)){
+			emptied = MM_FALSE;
+				continue;
+		}
 	
-	vm_page_family_t *vm_page_family = hosting_page->page_family;
+		assert(!((uintptr_t)(destination + 1) &
+				(vm_page_family->object_align - 1)));
+		mm_vm_page_mark_written(MM_GET_PAGE_FROM_META_BLOCK(destination),
+			(char *)(destination + 1) + destination->block_size +
+			sizeof(block_meta_data_t) + sizeof(glthread_t));
 	
-	return_block = to_be_free_block;
+		memcpy(destination + 1, curr + 1, curr->block_size);
+		MM_HEAP_PROFILE_MOVE(vm_page, curr + 1, destination + 1);
+		vm_page_family->relocate(curr + 1, destination + 1, curr->block_size,
+			vm_page_family->relocate_arg);
 	
-	to_be_free_block->is_free = MM_TRUE;
+		*bytes_grown += destination->block_size - curr->block_size;
+		curr->is_free = MM_TRUE;
 	
-	block_meta_data_t *next_block = NEXT_META_BLOCK(to_be_free_block);
+	} ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page, curr);
+	
+	return emptied;
+}
+
+/*Move the objects of a detached slab page into the partial slab pages*/
+static vm_bool_t
+mm_compact_slab_page(vm_page_family_t *vm_page_family, vm_page_t *vm_page){
 	
-	/*Handling Hard IF memory*/
-	if(next_block){
-		/*Scenario 1: When data block to be freed is not the last 
-					  upper most meta block in the VM page*/
-		to_be_free_block->block_size +=
-				mm_get_hard_internal_memory_frag_size(to_be_free_block, next_block);
+	vm_slab_meta_data_t *slab_meta_data = &vm_page->slab_meta_data;
+	uint64_t *bitmap = MM_SLAB_BITMAP(vm_page);
+	uint32_t index, word;
+	vm_bool_t known_zero;
+	void *destination;
+	
+	for(index = 0; slab_meta_data->n_free < slab_meta_data->n_objects; index++){
+	
+		word = index / 64;
+		if(!(bitmap[word] & (1ull << (index % 64))))
+			continue;
+	
+		/*mm_slab_allocate_object() would add a new page*/
+		if(!vm_page_family->partial_slab_list_head.right)
+			return MM_FALSE;
+	
+		destination = mm_slab_allocate_object(vm_page_family, &known_zero);
+		memcpy(destination, MM_SLAB_SLOT(vm_page, index), slab_meta_data->slot_size);
+		MM_HEAP_PROFILE_MOVE(vm_page, MM_SLAB_SLOT(vm_page, index), destination);
+		vm_page_family->relocate(MM_SLAB_SLOT(vm_page, index), destination,
+			slab_meta_data->slot_size, vm_page_family->relocate_arg);
+	
+		bitmap[word] &= ~(1ull << (index % 64));
+		if(word < slab_meta_data->free_word_hint)
+			slab_meta_data->free_word_hint = word;
+		slab_meta_data->n_free++;
+		vm_page_family->n_free_blocks++;
 	}
-	else{
-		/*Scenario 2: Page Boundary condition*/
-		/*Block begin frees is the upper most free data block
-		  in a VM data page, check for hard internal fragemented
-		  memory and merge*/
-		char *end_address_of_vm_page = (char *)((char *)hosting_page + SYSTEM_PAGE_SIZE);
-		char *end_address_of_free_data_block = 
-				(char *)(to_be_free_block + 1) + to_be_free_block->block_size;	
-		
-		int internal_mem_fragmentation = (int)((unsigned long)end_address_of_vm_page - 
-				(unsigned long)end_address_of_free_data_block);
-		
-		to_be_free_block->block_size += internal_mem_fragmentation;
+	return MM_TRUE;
+}
+
+/*Compaction of the pages of one family, node families are separate*/
+static uint32_t
+mm_family_compact(vm_page_family_t *vm_page_family){
+	
+	static const vm_page_type_t page_types[] = {MM_VM_PAGE_BLOCKS, MM_VM_PAGE_SLAB};
+	mm_compact_page_t *pages;
+	vm_page_t *vm_page, *released = NULL;
+	uint32_t n_pages = 0, n_sources, units, released_units = 0, i, t;
+	uint64_t bytes_grown = 0;
+	vm_bool_t emptied;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	
+	if(!vm_page_family->relocate){
+		MM_UNLOCK(&vm_page_family->family_lock);
+		printf("Error : %s() Page family %s has no relocation callback\n",
+			__FUNCTION__, vm_page_family->struct_name);
+		return 0;
 	}
 	
-	/*Now perform Merging*/
-	if(next_block && next_block->is_free == MM_TRUE){
-		/*Union two free blocks*/
-		mm_union_free_blocks(to_be_free_block, next_block);
-		return_block = to_be_free_block;
+#ifdef MM_THREAD_SAFE
+	mm_family_remote_free_drain(vm_page_family);
+#endif
+	
+	ITERATE_VM_PAGE_BEGIN(vm_page_family, vm_page){
+		n_pages++;
+	} ITERATE_VM_PAGE_END(vm_page_family, vm_page);
+	
+	units = (uint32_t)((n_pages * sizeof(mm_compact_page_t) + SYSTEM_PAGE_SIZE - 1)
+				>> SYSTEM_PAGE_SHIFT);
+	pages = n_pages ? mm_get_new_vm_page_from_kernel(units) : NULL;
+	
+	if(!pages){
+		mm_family_unlock(vm_page_family);
+		return 0;
 	}
-	/*Chech the previous block if it was free*/
-	block_meta_data_t *prev_block = PREV_META_BLOCK(to_be_free_block);
 	
-	if(prev_block && prev_block->is_free){
-		mm_union_free_blocks(prev_block, to_be_free_block);
-		return_block = prev_block;
+	/*Blocks move to blocks and slab objects to slots, a family with both
+	  kinds of pages is compacted twice*/
+	for(t = 0; t < sizeof(page_types) / sizeof(page_types[0]); t++){
+	
+		n_pages = mm_compact_collect(vm_page_family, page_types[t], pages);
+		n_sources = mm_compact_plan(pages, n_pages);
+	
+		for(i = 0; i < n_sources; i++)
+			mm_compact_detach(vm_page_family, pages[i].vm_page);
+	
+		for(i = 0; i < n_sources; i++){
+	
+			vm_page = pages[i].vm_page;
+			emptied = page_types[t] == MM_VM_PAGE_SLAB ?
+				mm_compact_slab_page(vm_page_family, vm_page) :
+				mm_compact_block_page(vm_page_family, vm_page, &bytes_grown);
+	
+			if(!emptied){
+				mm_compact_attach(vm_page_family, vm_page);
+				continue;
+			}
+	
+			if(page_types[t] == MM_VM_PAGE_SLAB)
+				vm_page_family->n_free_blocks -= vm_page->slab_meta_data.n_objects;
+	
+			/*Straight back to the kernel, retaining it would defeat the purpose*/
+			released_units += vm_page->page_units;
+			mm_vm_page_unlink(vm_page);
+			vm_page->next = released;
+			released = vm_page;
+		}
 	}
 	
-	if(mm_is_vm_page_empty(hosting_page)){
-		mm_vm_page_delete_and_free(hosting_page);
-		return NULL;
+	mm_family_unlock(vm_page_family);
+	
+	mm_return_vm_page_to_kernel(pages, units);
+	mm_page_cache_release(released,
+		__atomic_load_n(&page_release_mode, __ATOMIC_RELAXED));
+	
+	if(bytes_grown)
+		mm_count_objects(vm_page_family, 0, bytes_grown, 0, 0);
+	
+	return released_units;
+}
+
+uint32_t
+mm_compact(vm_page_family_t *vm_page_family){
+	
+	vm_page_family_t *node_family;
+	uint32_t released_units;
+	
+	if(!vm_page_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return 0;
 	}
 	
-	mm_add_free_block_meta_data_to_free_block_list(
-			hosting_page->page_family, return_block);
+	released_units = mm_family_compact(vm_page_family);
 	
-	return return_block;
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		released_units += mm_family_compact(node_family);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+	
+	return released_units;
 }
 
 
-void xfree(void *app_data){
+
+/*Walk of every block of the page family, the caller holds the family lock*/
+static void
+mm_family_block_usage(vm_page_family_t *vm_page_family, mm_block_usage_t *usage){
 	
-	block_meta_data_t *block_meta_data = 
-		(block_meta_data_t *)((char *)app_data - sizeof(block_meta_data_t));
+	vm_page_t *vm_page_curr;
+	block_meta_data_t *block_meta_data_curr;
 	
-	assert(block_meta_data->is_free == MM_FALSE);
-	mm_free_blocks(block_meta_data);
-} 
-
+	memset(usage, 0, sizeof(*usage));
+	
+	ITERATE_VM_PAGE_BEGIN(vm_page_family, vm_page_curr){
+		
+		usage->vm_pages += vm_page_curr->page_units;
+		
+		/*Page headers, the meta blocks are counted below*/
+		if(vm_page_curr->page_type != MM_VM_PAGE_SLAB)
+			usage->meta_data_usage += offset_of(vm_page_t, block_meta_data);
+		
+		/*Slab slots are accounted as blocks without meta data*/
+		if(vm_page_curr->page_type == MM_VM_PAGE_SLAB){
+			vm_slab_meta_data_t *slab_meta_data = &vm_page_curr->slab_meta_data;
+			usage->total_block_count += slab_meta_data->n_objects;
+			usage->free_block_count += slab_meta_data->n_free;
+			usage->occupied_block_count += slab_meta_data->n_objects - slab_meta_data->n_free;
+			usage->application_memory_usage += (uint64_t)slab_meta_data->slot_size *
+				(slab_meta_data->n_objects - slab_meta_data->n_free);
+			usage->free_memory += (uint64_t)slab_meta_data->slot_size *
+				slab_meta_data->n_free;
+			usage->meta_data_usage += slab_meta_data->first_slot_offset;
+			if(slab_meta_data->n_free &&
+				slab_meta_data->slot_size > usage->largest_free_block){
+				usage->largest_free_block = slab_meta_data->slot_size;
+			}
+			continue;
+		}
+		
+		ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page_curr, block_meta_data_curr){
+			
+			usage->total_block_count++;
+			
+			/*Sanity checks*/
+			if(block_meta_data_curr->is_free == MM_TRUE){
+				assert(!IS_GLTHREAD_LIST_EMPTY(
+							MM_FREE_BLOCK_GLUE(block_meta_data_curr)));
+			}
+			
+			usage->meta_data_usage += sizeof(block_meta_data_t);
+			
+			if(block_meta_data_curr->is_free == MM_TRUE){
+				usage->free_block_count++;
+				usage->free_memory += block_meta_data_curr->block_size;
+				if(block_meta_data_curr->block_size > usage->largest_free_block)
+					usage->largest_free_block = block_meta_data_curr->block_size;
+			}
+			
+			else{
+				usage->application_memory_usage +=
+					block_meta_data_curr->block_size + \
+					sizeof(block_meta_data_t);
+				usage->occupied_block_count++;
+			}
+		} ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page_curr, block_meta_data_curr);
+	} ITERATE_VM_PAGE_END(vm_page_family, vm_page_curr);
+}
 
+void
+mm_get_block_usage(vm_page_family_t *vm_page_family, mm_block_usage_t *usage){
+	
+	vm_page_family_t *node_family;
+	mm_block_usage_t node_usage;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	mm_family_block_usage(vm_page_family, usage);
+	MM_UNLOCK(&vm_page_family->family_lock);
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		
+		MM_LOCK(&node_family->family_lock);
+		mm_family_block_usage(node_family, &node_usage);
+		MM_UNLOCK(&node_family->family_lock);
+		
+		usage->vm_pages += node_usage.vm_pages;
+		usage->total_block_count += node_usage.total_block_count;
+		usage->free_block_count += node_usage.free_block_count;
+		usage->occupied_block_count += node_usage.occupied_block_count;
+		usage->application_memory_usage += node_usage.application_memory_usage;
+		usage->meta_data_usage += node_usage.meta_data_usage;
+		usage->free_memory += node_usage.free_memory;
+		if(node_usage.largest_free_block > usage->largest_free_block)
+			usage->largest_free_block = node_usage.largest_free_block;
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+}
 
 void
 mm_print_block_usage(){
-	vm_page_t *vm_page_curr;
 	vm_page_family_t *vm_page_family_curr;
-	block_meta_data_t *block_meta_data_curr;
-	uint32_t total_block_count, free_block_count,
-			 occupied_block_count;
-	uint32_t application_memory_usage;
-	
+	mm_block_usage_t usage;
 	
+	MM_REGISTRY_RDLOCK();
 	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
-	
-		total_block_count = 0;
-		free_block_count = 0;
-		application_memory_usage = 0;
 		
-		ITERATE_VM_PAGE_BEGIN(vm_page_family_curr, vm_page_curr){
-			
-			ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page_curr, block_meta_data_curr){
-				
-				total_block_count++;
-				
-				/*Sanity checks*/
-				if(block_meta_data_curr->is_free == MM_FALSE){
-					assert(IS_GLTHREAD_LIST_EMPTY(&block_meta_data_curr->	\
-								priority_thread_glue));
-				}
-				
-				if(block_meta_data_curr->is_free == MM_TRUE){
-					assert(!IS_GLTHREAD_LIST_EMPTY(&block_meta_data_curr->	\
-								priority_thread_glue));
-				}
-				
-				if(block_meta_data_curr->is_free == MM_TRUE){
-					free_block_count++;
-				}
-				
-				else{
-					application_memory_usage +=
-						block_meta_data_curr->block_size + \
-						sizeof(block_meta_data_t);
-					occupied_block_count++;
-				}
-			} ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page_curr, block_meta_data_curr);
-		} ITERATE_VM_PAGE_END(vm_page_family_curr, vm_page_curr);
+		/*Counted with their registered family*/
+		if(mm_is_node_family(vm_page_family_curr))
+			continue;
 		
+		mm_get_block_usage(vm_page_family_curr, &usage);
 		
-		printf("%-20s	TBC : %-4u	FBC : %-4u	OBC : %-4u AppMemUsage : %u\n",
-				vm_page_family_curr->struct_name, total_block_count,
-				free_block_count, occupied_block_count, application_memory_usage);
+		printf("%-20s	TBC : %-4u	FBC : %-4u	OBC : %-4u AppMemUsage : %lu"
+				"	MetaData : %lu\n",
+				vm_page_family_curr->struct_name, usage.total_block_count,
+				usage.free_block_count, usage.occupied_block_count,
+				(unsigned long)usage.application_memory_usage,
+				(unsigned long)usage.meta_data_usage);
 	
 	} ITERATE_PAGE_FAMILIES_END(first_vm_page_for_families, vm_page_family_curr);
+	MM_REGISTRY_UNLOCK();
 }
 
 void 
 mm_print_vm_page_details(vm_page_t *vm_page){
 	
 	printf("\t\t next = %p, prev = %p\n", vm_page->next, vm_page->prev);
-	printf("\t\t page family = %s\n", vm_page->page_family->struct_name);
+	printf("\t\t page family = %s, system pages = %u%s\n",
+			vm_page->page_family->struct_name, vm_page->page_units,
+			vm_page->page_type == MM_VM_PAGE_LARGE ? " (large)" : "");
+	
+	if(vm_page->page_type == MM_VM_PAGE_SLAB){
+		printf("\t\t\tSlab : slot_size = %-6u objects = %-6u free = %u\n",
+				vm_page->slab_meta_data.slot_size,
+				vm_page->slab_meta_data.n_objects,
+				vm_page->slab_meta_data.n_free);
+		return;
+	}
 	
 	uint32_t j = 0;
 	block_meta_data_t *curr;
@@ -579,23 +4474,399 @@ mm_print_vm_page_details(vm_page_t *vm_page){
 				curr,
 				j++, curr->is_free ? "FREED" : "ALLOCATED",
 				curr->block_size, curr->offset,
-				curr->prev_block,
-				curr->next_block);
+				PREV_META_BLOCK(curr),
+				NEXT_META_BLOCK(curr));
 	} ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page, curr);
 }
 				
 
 
+/*Add the counters of one family to stats, the derived ones are left*/
+static void
+mm_family_add_stats(vm_page_family_t *vm_page_family, mm_stats_t *stats){
+	
+	mm_object_counters_t counters, *family_counters;
+#ifdef MM_THREAD_SAFE
+	mm_magazine_t *magazine;
+#endif
+	
+	family_counters = &vm_page_family->object_counters;
+	
+	MM_LOCK(&vm_page_family->family_lock);
+	counters.allocations = __atomic_load_n(&family_counters->allocations,
+								__ATOMIC_RELAXED);
+	counters.frees = __atomic_load_n(&family_counters->frees, __ATOMIC_RELAXED);
+	counters.bytes_allocated = __atomic_load_n(&family_counters->bytes_allocated,
+								__ATOMIC_RELAXED);
+	counters.remote_allocations = __atomic_load_n(
+			&family_counters->remote_allocations, __ATOMIC_RELAXED);
+	counters.remote_frees = __atomic_load_n(&family_counters->remote_frees,
+								__ATOMIC_RELAXED);
+#ifdef MM_THREAD_SAFE
+	for(magazine = vm_page_family->magazines; magazine; magazine = magazine->next){
+		counters.allocations += __atomic_load_n(&magazine->counters.allocations,
+									__ATOMIC_RELAXED);
+		counters.frees += __atomic_load_n(&magazine->counters.frees,
+									__ATOMIC_RELAXED);
+		counters.bytes_allocated += __atomic_load_n(
+				&magazine->counters.bytes_allocated, __ATOMIC_RELAXED);
+		counters.remote_allocations += __atomic_load_n(
+				&magazine->counters.remote_allocations, __ATOMIC_RELAXED);
+		counters.remote_frees += __atomic_load_n(
+				&magazine->counters.remote_frees, __ATOMIC_RELAXED);
+	}
+#endif
+	stats->free_blocks += vm_page_family->n_free_blocks;
+	stats->vm_pages += vm_page_family->n_vm_pages;
+	stats->vm_pages_cached += vm_page_family->n_cached_vm_pages;
+	MM_UNLOCK(&vm_page_family->family_lock);
+	
+	stats->allocations += counters.allocations;
+	stats->frees += counters.frees;
+	stats->bytes_allocated += counters.bytes_allocated;
+	stats->numa_remote_allocations += counters.remote_allocations;
+	stats->numa_remote_frees += counters.remote_frees;
+	stats->mmap_calls += __atomic_load_n(&vm_page_family->n_mmap_calls,
+							__ATOMIC_RELAXED);
+	stats->munmap_calls += __atomic_load_n(&vm_page_family->n_munmap_calls,
+							__ATOMIC_RELAXED);
+}
+
+void
+mm_get_stats(vm_page_family_t *vm_page_family, mm_stats_t *stats){
+	
+	vm_page_family_t *node_family;
+	
+	memset(stats, 0, sizeof(*stats));
+	
+	if(!vm_page_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return;
+	}
+	
+	mm_family_add_stats(vm_page_family, stats);
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_family_add_stats(node_family, stats);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+	
+	stats->live_objects = stats->allocations - stats->frees;
+	stats->bytes_reserved = ((uint64_t)stats->vm_pages + stats->vm_pages_cached)
+								<< SYSTEM_PAGE_SHIFT;
+	stats->numa_local_allocations = stats->allocations -
+								stats->numa_remote_allocations;
+}
+
+void
+mm_set_latency_sampling(uint32_t period){
+	
+#ifdef MM_LATENCY_STATS
+	__atomic_store_n(&mm_latency_period, period, __ATOMIC_RELAXED);
+#else
+	(void)period;
+#endif
+}
+
+#ifdef MM_LATENCY_STATS
+/*Add the histogram of op for one family to histogram*/
+static void
+mm_latency_histogram_add(vm_page_family_t *vm_page_family, mm_latency_op_t op,
+						 mm_latency_histogram_t *histogram){
+	
+	mm_latency_histogram_t *source;
+	uint64_t max_ticks;
+	uint32_t i;
+	
+	if(!vm_page_family->latency_histograms)
+		return;
+	
+	/*Buckets keep counting meanwhile, the copy is not a snapshot*/
+	source = &vm_page_family->latency_histograms[op];
+	histogram->count += __atomic_load_n(&source->count, __ATOMIC_RELAXED);
+	histogram->total_ticks += __atomic_load_n(&source->total_ticks, __ATOMIC_RELAXED);
+	max_ticks = __atomic_load_n(&source->max_ticks, __ATOMIC_RELAXED);
+	if(max_ticks > histogram->max_ticks)
+		histogram->max_ticks = max_ticks;
+	for(i = 0; i < MM_LATENCY_BUCKETS; i++)
+		histogram->buckets[i] += __atomic_load_n(&source->buckets[i], __ATOMIC_RELAXED);
+}
+#endif
+
+void
+mm_get_latency_histogram(vm_page_family_t *vm_page_family, mm_latency_op_t op,
+						 mm_latency_histogram_t *histogram){
+	
+	memset(histogram, 0, sizeof(*histogram));
+	
+	if(!vm_page_family){
+		printf("Error : %s() Page family is not registered with Memory Manager\n",
+																	__FUNCTION__);
+		return;
+	}
+	
+#ifdef MM_LATENCY_STATS
+	vm_page_family_t *node_family;
+	
+	if(op >= MM_LATENCY_OPS)
+		return;
+	
+	mm_latency_histogram_add(vm_page_family, op, histogram);
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_latency_histogram_add(node_family, op, histogram);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+#else
+	(void)op;
+#endif
+}
+
+void
+mm_reset_latency_histograms(vm_page_family_t *vm_page_family){
+	
+#ifdef MM_LATENCY_STATS
+	vm_page_family_t *node_family;
+	mm_latency_histogram_t *histogram;
+	uint32_t i;
+	
+	if(!vm_page_family)
+		return;
+	
+	ITERATE_NODE_FAMILIES_BEGIN(vm_page_family, node_family){
+		mm_reset_latency_histograms(node_family);
+	} ITERATE_NODE_FAMILIES_END(vm_page_family, node_family);
+	
+	if(!vm_page_family->latency_histograms)
+		return;
+	
+	for(histogram = vm_page_family->latency_histograms;
+		histogram < vm_page_family->latency_histograms + MM_LATENCY_OPS;
+		histogram++){
+	
+		__atomic_store_n(&histogram->count, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&histogram->total_ticks, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&histogram->max_ticks, 0, __ATOMIC_RELAXED);
+		for(i = 0; i < MM_LATENCY_BUCKETS; i++)
+			__atomic_store_n(&histogram->buckets[i], 0, __ATOMIC_RELAXED);
+	}
+#else
+	(void)vm_page_family;
+#endif
+}
+
+uint64_t
+mm_latency_bucket_low(uint32_t bucket){
+	
+	uint32_t fl = bucket / MM_LATENCY_SUB_BUCKETS;
+	uint32_t sl = bucket % MM_LATENCY_SUB_BUCKETS;
+	
+	if(!fl)
+		return bucket;
+	return (uint64_t)(MM_LATENCY_SUB_BUCKETS + sl) << (fl - 1);
+}
+
+uint64_t
+mm_latency_bucket_high(uint32_t bucket){
+	
+	uint32_t fl = bucket / MM_LATENCY_SUB_BUCKETS;
+	
+	if(bucket == MM_LATENCY_BUCKETS - 1)
+		return UINT64_MAX;
+	if(!fl)
+		return bucket;
+	return mm_latency_bucket_low(bucket) + (1ull << (fl - 1)) - 1;
+}
+
+uint64_t
+mm_latency_percentile(const mm_latency_histogram_t *histogram, double percentile){
+	
+	uint64_t rank, seen = 0;
+	uint32_t i;
+	
+	if(!histogram->count)
+		return 0;
+	
+	rank = (uint64_t)(percentile / 100 * histogram->count + 0.5);
+	if(!rank)
+		rank = 1;
+	
+	for(i = 0; i < MM_LATENCY_BUCKETS; i++){
+		seen += histogram->buckets[i];
+		if(seen >= rank)
+			break;
+	}
+	
+	/*A bucket counting the slowest operations is bounded by the max*/
+	if(i == MM_LATENCY_BUCKETS ||
+		mm_latency_bucket_high(i) > histogram->max_ticks){
+		return histogram->max_ticks;
+	}
+	return mm_latency_bucket_high(i);
+}
+
+double
+mm_latency_ns_per_tick(){
+	
+#if defined(__x86_64__) || defined(__i386__)
+	static double ns_per_tick = 0;
+	struct timespec start_ts, end_ts;
+	uint64_t start;
+	double elapsed_ns, calibrated;
+	
+	__atomic_load(&ns_per_tick, &calibrated, __ATOMIC_RELAXED);
+	if(calibrated)
+		return calibrated;
+	
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+	start = __builtin_ia32_rdtsc();
+	do{
+		clock_gettime(CLOCK_MONOTONIC, &end_ts);
+		elapsed_ns = (end_ts.tv_sec - start_ts.tv_sec) * 1e9 +
+						(end_ts.tv_nsec - start_ts.tv_nsec);
+	} while(elapsed_ns < 10e6);
+	
+	calibrated = elapsed_ns / (double)(__builtin_ia32_rdtsc() - start);
+	__atomic_store(&ns_per_tick, &calibrated, __ATOMIC_RELAXED);
+	return calibrated;
+#else
+	return 1;
+#endif
+}
+
+void
+mm_print_latency_histograms(int verbose){
+	
+#ifdef MM_LATENCY_STATS
+	static const char *op_names[MM_LATENCY_OPS] = {
+		"alloc",
+		"free",
+		"page_acquire",
+		"page_release"
+	};
+	vm_page_family_t *vm_page_family_curr;
+	mm_latency_histogram_t histogram;
+	double ns_per_tick = mm_latency_ns_per_tick();
+	uint32_t op, i;
+	
+	printf("%-32s %-13s %10s %9s %9s %9s %9s %9s\n", "vm_page_family", "op",
+			"count", "mean_ns", "p50_ns", "p99_ns", "p999_ns", "max_ns");
+	
+	MM_REGISTRY_RDLOCK();
+	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
+	
+		/*Counted with their registered family*/
+		if(mm_is_node_family(vm_page_family_curr))
+			continue;
+	
+		for(op = 0; op < MM_LATENCY_OPS; op++){
+	
+			mm_get_latency_histogram(vm_page_family_curr, op, &histogram);
+			if(!histogram.count)
+				continue;
+	
+			printf("%-32s %-13s %10lu %9.0f %9.0f %9.0f %9.0f %9.0f\n",
+				vm_page_family_curr->struct_name, op_names[op],
+				(unsigned long)histogram.count,
+				histogram.total_ticks * ns_per_tick / histogram.count,
+				mm_latency_percentile(&histogram, 50) * ns_per_tick,
+				mm_latency_percentile(&histogram, 99) * ns_per_tick,
+				mm_latency_percentile(&histogram, 99.9) * ns_per_tick,
+				histogram.max_ticks * ns_per_tick);
+	
+			if(!verbose)
+				continue;
+	
+			for(i = 0; i < MM_LATENCY_BUCKETS; i++){
+				if(!histogram.buckets[i])
+					continue;
+				printf("\t%12.0f - %-12.0f ns : %lu\n",
+					mm_latency_bucket_low(i) * ns_per_tick,
+					i == MM_LATENCY_BUCKETS - 1 ?
+						histogram.max_ticks * ns_per_tick :
+						(mm_latency_bucket_high(i) + 1) * ns_per_tick,
+					(unsigned long)histogram.buckets[i]);
+			}
+		}
+	
+	} ITERATE_PAGE_FAMILIES_END(first_vm_page_for_families, vm_page_family_curr);
+	MM_REGISTRY_UNLOCK();
+#else
+	(void)verbose;
+	printf("Error : %s() Memory Manager was built without MM_LATENCY_STATS\n",
+		__FUNCTION__);
+#endif
+}
+
+void mm_get_memory_usage(char *struct_name, mm_memory_usage_t *usage){
+	
+	vm_page_t *vm_page;
+	vm_page_family_t *vm_page_family_curr;
+	vm_arena_t *arena;
+	
+	memset(usage, 0, sizeof(*usage));
+	
+	MM_REGISTRY_RDLOCK();
+	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
+		
+		if(struct_name){
+			if(strncmp(struct_name, vm_page_family_curr->struct_name,
+						strlen(vm_page_family_curr->struct_name))){
+				continue;
+			}
+		}
+		
+		MM_LOCK(&vm_page_family_curr->family_lock);
+		ITERATE_VM_PAGE_BEGIN(vm_page_family_curr, vm_page){
+			usage->vm_pages_in_use += vm_page->page_units;
+		} ITERATE_VM_PAGE_END(vm_page_family_curr, vm_page);
+		
+		for(vm_page = vm_page_family_curr->empty_pages; vm_page;
+			vm_page = vm_page->next){
+			usage->vm_pages_cached += vm_page->page_units;
+		}
+		MM_UNLOCK(&vm_page_family_curr->family_lock);
+		
+	} ITERATE_PAGE_FAMILIES_END(first_vm_page_for_families, vm_page_family_curr);
+	MM_REGISTRY_UNLOCK();
+	
+	if(!struct_name){
+		MM_LOCK(&global_page_cache_lock);
+		for(vm_page = global_empty_pages; vm_page; vm_page = vm_page->next)
+			usage->vm_pages_cached += vm_page->page_units;
+		MM_UNLOCK(&global_page_cache_lock);
+	}
+	
+	MM_LOCK(&mm_arena_lock);
+	for(arena = arenas; arena; arena = arena->next){
+		if(struct_name &&
+			strncmp(struct_name, arena->name, strlen(arena->name))){
+			continue;
+		}
+		usage->vm_pages_in_use += __atomic_load_n(&arena->n_units,
+									__ATOMIC_RELAXED);
+	}
+	MM_UNLOCK(&mm_arena_lock);
+	
+	MM_LOCK(&mm_chunk_lock);
+	usage->n_chunks = n_chunks;
+	usage->chunk_bytes_reserved = (uint64_t)chunk_reserved_units << SYSTEM_PAGE_SHIFT;
+	MM_UNLOCK(&mm_chunk_lock);
+}
+
 void mm_print_memory_usage(char *struct_name){
 	
 	uint32_t i = 0;
 	vm_page_t *vm_page = NULL;
 	vm_page_family_t *vm_page_family_curr;
+	vm_arena_t *arena;
+	uint64_t arena_units;
 	uint32_t number_of_struct_families = 0;
 	uint32_t cumulative_vm_pages_claimed_from_kernel = 0;
+	uint32_t cumulative_vm_pages_cached = 0;
 	
 	printf("\nPage Size = %zu Bytes\n", SYSTEM_PAGE_SIZE);
 	
+	MM_REGISTRY_RDLOCK();
 	ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
 	
 		if(struct_name){
@@ -607,27 +4878,72 @@ void mm_print_memory_usage(char *struct_name){
 		
 		number_of_struct_families++;
 		
-		printf(ANSI_COLOR_GREEN "vm_page_family : %s, struct size = %u\n" \
-			   ANSI_COLOR_RESET,
+		printf(ANSI_COLOR_GREEN "vm_page_family : %s, struct size = %u",
 			   vm_page_family_curr->struct_name,
 			   vm_page_family_curr->struct_size);
+		if(vm_page_family_curr->numa_node >= 0)
+			printf(", numa node %d", vm_page_family_curr->numa_node);
+		printf("\n" ANSI_COLOR_RESET);
 		
 		i = 0;
+		MM_LOCK(&vm_page_family_curr->family_lock);
 		ITERATE_VM_PAGE_BEGIN(vm_page_family_curr, vm_page){
 			
-			cumulative_vm_pages_claimed_from_kernel++;
+			cumulative_vm_pages_claimed_from_kernel += vm_page->page_units;
 			mm_print_vm_page_details(vm_page);
 			
 		} ITERATE_VM_PAGE_END(vm_page_family_curr, vm_page);
+		
+		for(vm_page = vm_page_family_curr->empty_pages; vm_page;
+			vm_page = vm_page->next){
+			cumulative_vm_pages_cached += vm_page->page_units;
+		}
+		printf("Cached empty VM pages : %u\n",
+			vm_page_family_curr->n_empty_pages);
+		MM_UNLOCK(&vm_page_family_curr->family_lock);
 		printf("\n");
 	
 	} ITERATE_PAGE_FAMILIES_END(first_vm_page_for_families, vm_page_family_curr);
+	MM_REGISTRY_UNLOCK();
+	
+	MM_LOCK(&mm_arena_lock);
+	for(arena = arenas; arena; arena = arena->next){
+		
+		if(struct_name &&
+			strncmp(struct_name, arena->name, strlen(arena->name))){
+			continue;
+		}
+		
+		arena_units = __atomic_load_n(&arena->n_units, __ATOMIC_RELAXED);
+		cumulative_vm_pages_claimed_from_kernel += arena_units;
+		printf(ANSI_COLOR_GREEN "arena : %s\n" ANSI_COLOR_RESET, arena->name);
+		printf("VM pages : %lu, bytes allocated : %lu\n\n",
+			(unsigned long)arena_units,
+			(unsigned long)__atomic_load_n(&arena->bytes_allocated,
+								__ATOMIC_RELAXED));
+	}
+	MM_UNLOCK(&mm_arena_lock);
 	
 	printf(ANSI_COLOR_MAGENTA "# Of VM Pages in use : %u (%lu Bytes)\n" \
 			ANSI_COLOR_RESET,
 			cumulative_vm_pages_claimed_from_kernel,
 			SYSTEM_PAGE_SIZE * cumulative_vm_pages_claimed_from_kernel);
 	
+	if(!struct_name){
+		MM_LOCK(&global_page_cache_lock);
+		for(vm_page = global_empty_pages; vm_page; vm_page = vm_page->next)
+			cumulative_vm_pages_cached += vm_page->page_units;
+		MM_UNLOCK(&global_page_cache_lock);
+	}
+	printf("# Of cached empty VM Pages : %u (%lu Bytes)\n",
+			cumulative_vm_pages_cached,
+			SYSTEM_PAGE_SIZE * cumulative_vm_pages_cached);
+	
+	MM_LOCK(&mm_chunk_lock);
+	printf("# Of chunks : %u (%lu Bytes reserved)\n", n_chunks,
+			(unsigned long)(chunk_reserved_units << SYSTEM_PAGE_SHIFT));
+	MM_UNLOCK(&mm_chunk_lock);
+	
 	float memory_app_use_to_total_memory_ratio = 0.0;
 	
 	printf("Total Memory being used by Memory Manager = %lu Bytes\n",
@@ -1,21 +1,90 @@
 #include <stdint.h>
 #include "glthread.h"
 
+/*Build with -DMM_THREAD_SAFE for a thread safe memory manager. Every
+  page family then has its own lock and each thread keeps per family
+  magazines of free objects, see mm_thread_cache_t*/
+#ifdef MM_THREAD_SAFE
+#include <pthread.h>
+typedef pthread_mutex_t mm_lock_t;
+#define MM_LOCK_INIT(lock_ptr)	pthread_mutex_init(lock_ptr, NULL)
+#define MM_LOCK(lock_ptr)		pthread_mutex_lock(lock_ptr)
+#define MM_UNLOCK(lock_ptr)		pthread_mutex_unlock(lock_ptr)
+#define MM_TRYLOCK(lock_ptr)	(pthread_mutex_trylock(lock_ptr) == 0)
+#else
+typedef char mm_lock_t;
+#define MM_LOCK_INIT(lock_ptr)
+#define MM_LOCK(lock_ptr)
+#define MM_UNLOCK(lock_ptr)
+#endif
+
+/*Build with -DMM_LATENCY_STATS to time the allocation and free paths
+  into per family histograms, see mm_get_latency_histogram(). Without
+  it the timing compiles to nothing*/
+#ifdef MM_LATENCY_STATS
+#define MM_LATENCY_START(start)	uint64_t start = mm_latency_start(MM_TRUE)
+#define MM_LATENCY_START_ALWAYS(start)	uint64_t start = mm_latency_start(MM_FALSE)
+#define MM_LATENCY_END(family_ptr, op, start)			\
+	do{													\
+		if(start)										\
+			mm_latency_record(family_ptr, op, start);	\
+	} while(0)
+#else
+#define MM_LATENCY_START(start)
+#define MM_LATENCY_START_ALWAYS(start)
+#define MM_LATENCY_END(family_ptr, op, start)
+#endif
+
+/*Build with -DMM_HEAP_PROFILE to sample allocations with their call
+  stacks, see mm_dump_heap_profile(). An allocation costs a thread local
+  subtraction unless sampled, a free a load from its VM data page unless
+  the page holds sampled objects*/
+#ifdef MM_HEAP_PROFILE
+#define MM_HEAP_PROFILE_ALLOC(family_ptr, app_data, size)				\
+	do{																	\
+		if((mm_heap_profile_countdown -= (size)) < 0)					\
+			mm_heap_profile_sample(family_ptr, app_data, size);			\
+	} while(0)
+#define MM_HEAP_PROFILE_FREE(vm_page_ptr, app_data)						\
+	do{																	\
+		if(__atomic_load_n(&(vm_page_ptr)->n_sampled, __ATOMIC_RELAXED))\
+			mm_heap_profile_forget(vm_page_ptr, app_data);				\
+	} while(0)
+#define MM_HEAP_PROFILE_MOVE(vm_page_ptr, old_address, new_address)		\
+	do{																	\
+		if((vm_page_ptr)->n_sampled)									\
+			mm_heap_profile_move(vm_page_ptr, old_address, new_address);\
+	} while(0)
+#else
+#define MM_HEAP_PROFILE_ALLOC(family_ptr, app_data, size)
+#define MM_HEAP_PROFILE_FREE(vm_page_ptr, app_data)
+#define MM_HEAP_PROFILE_MOVE(vm_page_ptr, old_address, new_address)
+#endif
+
 typedef enum{
 	MM_FALSE,
 	MM_TRUE
 } vm_bool_t;
 
+/*Meta block in front of every data block. Blocks of a page tile it
+  with no gaps, the next block starts right after the data and the
+  previous one is found by its offset. A free block links into its
+  size class list through its own data, see MM_FREE_BLOCK_GLUE*/
 typedef struct block_meta_data_{
 	vm_bool_t is_free;
 	uint32_t block_size;
 	uint32_t offset;	/*offset from thy start of the page*/
-	glthread_t priority_thread_glue;
-	struct block_meta_data_ *prev_block;
-	struct block_meta_data_ *next_block;
+	uint32_t prev_offset;	/*offset of the previous block, 0 for the first*/
 } block_meta_data_t;
-GLTHREAD_TO_STRUCT(glthread_to_block_meta_data,
-	block_meta_data_t, priority_thread_glue, glthread_ptr);
+
+/*Data blocks are big enough to hold the free list links*/
+#define MM_MIN_BLOCK_SIZE	sizeof(glthread_t)
+
+#define MM_FREE_BLOCK_GLUE(block_meta_data_ptr)	\
+	((glthread_t *)((block_meta_data_ptr) + 1))
+
+#define glthread_to_block_meta_data(glthread_ptr)	\
+	((block_meta_data_t *)(glthread_ptr) - 1)
 
 #define offset_of(container_structure, field_name)	\
 	((size_t)&(((container_structure *)0) -> field_name))
@@ -23,36 +92,106 @@ GLTHREAD_TO_STRUCT(glthread_to_block_meta_data,
 /*Forward Declaration*/
 struct vm_page_family_;
 
+typedef enum{
+	MM_VM_PAGE_BLOCKS,	/*data blocks, each behind a block_meta_data_t*/
+	MM_VM_PAGE_SLAB,	/*fixed size objects, no per object meta data*/
+	MM_VM_PAGE_LARGE	/*dedicated region holding one allocated block*/
+} vm_page_type_t;
+
+/*Meta data of a slab page. An occupancy bitmap of
+  ceil(n_objects/64) words starts at page_memory, object slots
+  of slot_size bytes start at first_slot_offset*/
+typedef struct vm_slab_meta_data_{
+	uint32_t n_objects;
+	uint32_t n_free;
+	uint32_t slot_size;
+	uint32_t first_slot_offset;	/*offset of slot 0 from the start of the page*/
+	uint32_t free_word_hint;	/*no bitmap word below this one has a free bit*/
+	glthread_t partial_slab_glue;	/*links the page into the partial slab list*/
+} vm_slab_meta_data_t;
+
+/*Chunk : one mapping of units system pages that spans are carved from,
+  so the heap grows by one mmap per chunk rather than per page. The
+  header and the bitmap of the pages in use occupy the first
+  header_units pages. Released pages are madvise'd and a chunk is
+  unmapped once none of its pages is in use*/
+typedef struct mm_chunk_{
+	struct mm_chunk_ *next;
+	struct mm_chunk_ **owner;	/*head of the chunk list holding it*/
+	uint32_t units;
+	uint32_t header_units;
+	uint32_t carved_units;	/*pages above were never handed out*/
+	uint32_t used_units;	/*pages handed out and not released*/
+	vm_bool_t hugetlb;		/*mapped from the hugetlbfs pool*/
+	vm_bool_t released_dirty;	/*released pages may not read as zero*/
+	uint64_t bitmap[0];
+} mm_chunk_t;
+
 typedef struct vm_page_{
 	struct vm_page_ *next;
 	struct vm_page_ *prev;
 	struct vm_page_family_ *page_family;	/*back pointer*/
-	uint32_t page_index;
-	block_meta_data_t block_meta_data;
+	mm_chunk_t *chunk;	/*NULL for a region mapped on its own*/
+	uint32_t n_sampled;	/*objects of the page sampled by the heap profiler*/
+	uint32_t page_units;	/*number of system pages spanned*/
+	vm_page_type_t page_type : 8;
+	/*Data bytes of the listed free blocks of a MM_VM_PAGE_BLOCKS page,
+	  spans of MM_MAX_SPAN_UNITS pages fit*/
+	uint32_t free_bytes : 24;
+	/*Bytes from zero_offset to the end of the page were zero when the
+	  page was obtained and never handed out since*/
+	uint32_t zero_offset;
+	union{
+		block_meta_data_t block_meta_data;	/*MM_VM_PAGE_BLOCKS*/
+		vm_slab_meta_data_t slab_meta_data;	/*MM_VM_PAGE_SLAB*/
+	};
 	char page_memory[0];
 } vm_page_t;
 
+GLTHREAD_TO_STRUCT(glthread_to_vm_page_slab,
+	vm_page_t, slab_meta_data.partial_slab_glue, glthread_ptr);
+
+/*Slots start aligned to the largest power of two dividing their size,
+  up to this*/
+#define MM_SLAB_MAX_SLOT_ALIGN	64
+
+#define MM_SLAB_BITMAP(vm_page_ptr)	\
+	((uint64_t *)(vm_page_ptr)->page_memory)
+
+#define MM_SLAB_SLOT(vm_page_ptr, index)								\
+	((void *)((char *)(vm_page_ptr) +									\
+		(vm_page_ptr)->slab_meta_data.first_slot_offset +				\
+		(size_t)(index) * (vm_page_ptr)->slab_meta_data.slot_size))
+
 
 #define MM_GET_PAGE_FROM_META_BLOCK(block_meta_data_ptr)	\
 	((void *) ((char *)block_meta_data_ptr - block_meta_data_ptr->offset))
 
 	
 #define NEXT_META_BLOCK(block_meta_data_ptr)	\
-	(block_meta_data_ptr->next_block)
+	(mm_next_meta_block(block_meta_data_ptr))
 
 #define NEXT_META_BLOCK_BY_SIZE(block_meta_data_ptr)	\
 	(block_meta_data_t *) ((char *) (block_meta_data_ptr + 1)	\
 		+ block_meta_data_ptr->block_size)
 
-#define PREV_META_BLOCK(block_meta_data_ptr)	\
-	(block_meta_data_ptr -> prev_block)
+#define PREV_META_BLOCK(block_meta_data_ptr)							\
+	((block_meta_data_ptr)->prev_offset ?								\
+		(block_meta_data_t *)((char *)MM_GET_PAGE_FROM_META_BLOCK(		\
+			block_meta_data_ptr) + (block_meta_data_ptr)->prev_offset) :	\
+		NULL)
 
 #define mm_bind_blocks_for_allocation(allocated_meta_block, free_meta_block)	\
-	free_meta_block->prev_block = allocated_meta_block;							\
-	free_meta_block->next_block = allocated_meta_block->next_block;				\
-	allocated_meta_block->next_block = free_meta_block;							\
-	if (free_meta_block->next_block)											\
-		free_meta_block->next_block->prev_block = free_meta_block;
+	{																			\
+		block_meta_data_t *_next_block = NEXT_META_BLOCK(free_meta_block);	\
+		free_meta_block->prev_offset = allocated_meta_block->offset;			\
+		if (_next_block)														\
+			_next_block->prev_offset = free_meta_block->offset;					\
+	}
+
+/*Block following block_meta_data in its page, NULL for the last one*/
+block_meta_data_t *
+mm_next_meta_block(block_meta_data_t *block_meta_data);
 		
 
 vm_bool_t
@@ -61,14 +200,184 @@ mm_is_vm_page_empty(vm_page_t *vm_page);
 
 #define MM_MAX_STRUCT_NAME 32
 
+/*Segregated free block lists, TLSF style. A free block of size s lands
+  in first level class fl = log2(s) and in one of MM_FREE_BLOCK_SL_COUNT
+  linear second level classes within [2^fl, 2^(fl+1)). Sizes below
+  2^MM_FREE_BLOCK_FL_SHIFT share first level class 0 in linear steps of
+  MM_ALIGNMENT. A bitmap of non empty classes per level makes finding,
+  inserting and removing a free block O(1)*/
+#define MM_ALIGNMENT_LOG2	3
+#define MM_ALIGNMENT		(1 << MM_ALIGNMENT_LOG2)
+#define MM_ALIGN_UP(size)	\
+	(((size) + MM_ALIGNMENT - 1) & ~(uint32_t)(MM_ALIGNMENT - 1))
+
+/*Round size up to a multiple of align, a power of 2*/
+#define MM_ALIGN_UP_TO(size, align)	\
+	(((size) + (align) - 1) & ~((align) - 1))
+
+/*Data block size serving a request of size bytes*/
+#define MM_BLOCK_SIZE(size)	\
+	(MM_ALIGN_UP(size) < MM_MIN_BLOCK_SIZE ? MM_MIN_BLOCK_SIZE : MM_ALIGN_UP(size))
+
+#define MM_FREE_BLOCK_SL_COUNT_LOG2	2
+#define MM_FREE_BLOCK_SL_COUNT		(1 << MM_FREE_BLOCK_SL_COUNT_LOG2)
+#define MM_FREE_BLOCK_FL_SHIFT		(MM_FREE_BLOCK_SL_COUNT_LOG2 + MM_ALIGNMENT_LOG2)
+/*Blocks of 2^(MM_FREE_BLOCK_FL_MAX + 1) bytes or more share the last class*/
+#define MM_FREE_BLOCK_FL_MAX		23
+#define MM_FREE_BLOCK_FL_COUNT		(MM_FREE_BLOCK_FL_MAX - MM_FREE_BLOCK_FL_SHIFT + 2)
+
+/*Object counters of a page family, see mm_get_stats(). In MM_THREAD_SAFE
+  builds every thread counts into its own magazines, the family keeps
+  what exited threads counted and what threads without a magazine count*/
+typedef struct mm_object_counters_{
+	uint64_t allocations;
+	uint64_t frees;
+	uint64_t bytes_allocated;	/*may wrap in one thread, the sum cannot*/
+	uint64_t remote_allocations;	/*by a thread of another NUMA node*/
+	uint64_t remote_frees;
+} mm_object_counters_t;
+
+/*Nodes of NUMA families beyond this one share the pages of the first node*/
+#define MM_NUMA_MAX_NODES	8
+
 typedef struct vm_page_family_{
 	
 	char struct_name[MM_MAX_STRUCT_NAME];
 	uint32_t struct_size;
+	uint32_t name_hash;	/*hash of struct_name, see page family registry*/
+	uint32_t flags;		/*MM_FAMILY_* registration flags*/
+	uint32_t object_align;	/*data of every object starts on this boundary*/
+	uint32_t family_id;	/*registration order, indexes per thread caches*/
+	uint32_t span_units;	/*system pages per new VM data page (span)*/
+	uint32_t large_threshold;	/*bigger requests get a dedicated region*/
+	/*NUMA node new pages are bound to, -1 for none. A MM_FAMILY_NUMA_LOCAL
+	  family serves the first node and keeps one more family per other
+	  node, with its own pages and free lists. Those are not in the
+	  registry, allocations through the handle are routed to them*/
+	int32_t numa_node;
+	struct vm_page_family_ *node_families[MM_NUMA_MAX_NODES];
+	mm_lock_t family_lock;	/*guards pages and free lists of the family*/
+#ifdef MM_THREAD_SAFE
+	/*Lock free MPSC stack of objects freed while family_lock was busy,
+	  linked through their first word. Drained by the next lock holder*/
+	void *remote_free_head;
+#endif
 	struct vm_page_ *first_page;
-	glthread_t free_block_priority_list_head;
+	/*Empty spans retained for reuse, linked through next, see
+	  mm_family_set_page_cache_watermarks()*/
+	struct vm_page_ *empty_pages;
+	uint32_t n_empty_pages;
+	/*Pages dropped by the caches under family_lock, released once it is
+	  let go, see mm_family_unlock()*/
+	struct vm_page_ *release_pages;
+	uint32_t empty_pages_low;
+	uint32_t empty_pages_high;
+	mm_chunk_t *chunks;		/*newest first, guarded by the chunk lock*/
+	uint32_t next_chunk_units;	/*doubles with every new chunk*/
+	uint32_t huge_pages;	/*mm_huge_pages_t backing new chunks*/
+	glthread_t partial_slab_list_head;	/*slab pages with a free slot*/
+	uint32_t free_block_fl_bitmap;
+	uint32_t free_block_sl_bitmap[MM_FREE_BLOCK_FL_COUNT];
+	glthread_t free_block_lists[MM_FREE_BLOCK_FL_COUNT][MM_FREE_BLOCK_SL_COUNT];
+	/*Counters of mm_get_stats(), the kernel call ones are atomic, the
+	  others are guarded by family_lock*/
+	mm_object_counters_t object_counters;
+	uint64_t n_free_blocks;	/*listed free blocks and free slab slots*/
+	uint32_t n_vm_pages;	/*system pages of the first_page list*/
+	uint32_t n_cached_vm_pages;	/*system pages of the empty_pages list*/
+	uint64_t n_mmap_calls;
+	uint64_t n_munmap_calls;
+#ifdef MM_THREAD_SAFE
+	struct mm_magazine_ *magazines;	/*of all threads, guarded by family_lock*/
+#endif
+	/*Moves objects for mm_compact(), see mm_family_set_relocation_callback()*/
+	void (*relocate)(void *old_address, void *new_address, uint32_t size,
+					 void *arg);
+	void *relocate_arg;
+#ifdef MM_LATENCY_STATS
+	/*MM_LATENCY_OPS histograms, NULL when they could not be allocated*/
+	struct mm_latency_histogram_ *latency_histograms;
+#endif
 } vm_page_family_t;
 
+#ifdef MM_THREAD_SAFE
+/*Per thread cache : one magazine of free objects per page family, used
+  for single object requests without taking the family lock. An empty
+  magazine is refilled and a full one drained by MM_MAGAZINE_BATCH
+  objects under the family lock*/
+#define MM_MAGAZINE_SIZE	64
+#define MM_MAGAZINE_BATCH	(MM_MAGAZINE_SIZE / 2)
+#define MM_MAGAZINE_KNOWN_ZERO	1ul
+#define MM_MAGAZINE_OBJECT(entry)	\
+	((void *)((uintptr_t)(entry) & ~MM_MAGAZINE_KNOWN_ZERO))
+
+typedef struct mm_magazine_{
+	vm_page_family_t *vm_page_family;
+	struct mm_magazine_ *next;	/*next magazine of the family*/
+	mm_object_counters_t counters;	/*written by the owning thread only*/
+	uint32_t count;
+	/*Objects known to hold zeros are tagged with MM_MAGAZINE_KNOWN_ZERO*/
+	void *objects[MM_MAGAZINE_SIZE];
+} mm_magazine_t;
+
+typedef struct mm_thread_cache_{
+	mm_magazine_t **magazines;	/*indexed by family_id*/
+	uint32_t n_magazines;
+	char *magazine_pool;		/*magazines are bump allocated from VM pages*/
+	uint32_t magazine_pool_free;
+	void *magazine_pages;		/*list of those VM pages*/
+} mm_thread_cache_t;
+#endif
+
+#ifdef MM_HEAP_PROFILE
+#define MM_HEAP_PROFILE_MAX_FRAMES	32
+
+/*Live object sampled by the heap profiler, hashed by app_data*/
+typedef struct mm_heap_sample_{
+	struct mm_heap_sample_ *next;	/*in its bucket or in the free list*/
+	void *app_data;
+	vm_page_family_t *vm_page_family;
+	uint64_t bytes;		/*live bytes the sample stands for*/
+	uint32_t n_frames;
+	void *frames[MM_HEAP_PROFILE_MAX_FRAMES];	/*innermost first*/
+} mm_heap_sample_t;
+#endif
+
+/*A VM data page considered by mm_compact(), live and free are bytes in
+  data blocks or slots of a slab page*/
+typedef struct mm_compact_page_{
+	struct vm_page_ *vm_page;
+	uint64_t live;
+	uint64_t free;
+} mm_compact_page_t;
+
+/*Arena : a list of pages obtained from the kernel, the first one holding
+  the arena itself, objects are bump allocated from the cursor of the
+  current page. Pages double in size up to MM_ARENA_MAX_PAGE_UNITS and
+  are kept across resets. Requests over a quarter of the biggest page
+  get a page of their own, given back by the next reset*/
+#define MM_ARENA_ALIGNMENT		16
+#define MM_ARENA_MAX_PAGE_UNITS	MM_MAX_SPAN_UNITS
+
+typedef struct vm_arena_page_{
+	struct vm_arena_page_ *next;
+	uint64_t units;		/*system pages spanned*/
+} vm_arena_page_t;
+
+typedef struct vm_arena_{
+	char name[MM_MAX_STRUCT_NAME];
+	struct vm_arena_ *next;		/*in the list of all arenas*/
+	struct vm_arena_ *prev;
+	vm_arena_page_t *first_page;
+	vm_arena_page_t *curr_page;	/*pages after it are unused*/
+	vm_arena_page_t *large_pages;
+	char *cursor;	/*next free byte of curr_page*/
+	char *end;		/*end of curr_page*/
+	/*Read by mm_print_memory_usage() from other threads*/
+	uint64_t n_units;	/*system pages of all pages of the arena*/
+	uint64_t bytes_allocated;	/*since the last reset*/
+} vm_arena_t;
+
 typedef struct vm_page_for_families_{
 	
 	struct vm_page_for_families_ *next;
@@ -77,27 +386,87 @@ typedef struct vm_page_for_families_{
 
 
 
+/*Map a block size to its (first level, second level) free list class*/
+static inline void
+mm_free_block_list_mapping(uint32_t size, uint32_t *fl, uint32_t *sl){
+	
+	uint32_t msb;
+	
+	if(size < (1u << MM_FREE_BLOCK_FL_SHIFT)){
+		*fl = 0;
+		*sl = size >> MM_ALIGNMENT_LOG2;
+		return;
+	}
+	
+	msb = 31 - __builtin_clz(size);
+	
+	if(msb > MM_FREE_BLOCK_FL_MAX){
+		*fl = MM_FREE_BLOCK_FL_COUNT - 1;
+		*sl = MM_FREE_BLOCK_SL_COUNT - 1;
+		return;
+	}
+	
+	*fl = msb - MM_FREE_BLOCK_FL_SHIFT + 1;
+	*sl = (size >> (msb - MM_FREE_BLOCK_SL_COUNT_LOG2)) ^ MM_FREE_BLOCK_SL_COUNT;
+}
+
+/*Returns a free block from the highest non empty size class, this is
+  the biggest free block of the family up to the granularity of a class*/
 static inline block_meta_data_t *
 mm_get_biggest_free_block_page_family(
 		vm_page_family_t *vm_page_family){	
 	
-	glthread_t *biggest_free_block_glue =
-		vm_page_family->free_block_priority_list_head.right;
-		
-	if(biggest_free_block_glue)
-		return glthread_to_block_meta_data(biggest_free_block_glue);
+	uint32_t fl, sl;
 	
-	return NULL;
-
+	if(!vm_page_family->free_block_fl_bitmap)
+		return NULL;
+	
+	fl = 31 - __builtin_clz(vm_page_family->free_block_fl_bitmap);
+	sl = 31 - __builtin_clz(vm_page_family->free_block_sl_bitmap[fl]);
+	
+	return glthread_to_block_meta_data(
+			vm_page_family->free_block_lists[fl][sl].right);
 }
 
+/*Free blocks looked at per allocation by the best fit and densest page
+  placement policies, and in the size class of the request by first fit*/
+#define MM_PLACEMENT_SCAN_MAX	16
+
+/*Upper bound of a span, bigger requests always get a dedicated region*/
+#define MM_MAX_SPAN_UNITS	256
+
+/*A span is grown at registration until it holds this many objects*/
+#define MM_MIN_OBJECTS_PER_SPAN	4
+
+/*Empty page cache : spans emptied by xfree are kept by their family
+  and past its high watermark handed to a global cache shared by all
+  families, both trimmed back to their low watermark in one batch*/
+#define MM_FAMILY_PAGE_CACHE_LOW	1
+#define MM_FAMILY_PAGE_CACHE_HIGH	4
+#define MM_GLOBAL_PAGE_CACHE_LOW	16
+#define MM_GLOBAL_PAGE_CACHE_HIGH	64
+
+/*Chunks of a page family start at MM_CHUNK_MIN_SIZE bytes and double up
+  to MM_CHUNK_MAX_SIZE. Bigger requests are mapped on their own*/
+#define MM_CHUNK_MIN_SIZE	(2ul << 20)
+#define MM_CHUNK_MAX_SIZE	(1ul << 30)
+
+/*Chunks are aligned to the PMD huge page size*/
+#define MM_HUGE_PAGE_SIZE	(2ul << 20)
+
+/*Page map : two level radix tree from the number of a system page to the
+  VM data page (span or large region) covering it. Covers 48 bit virtual
+  addresses, each leaf maps 2^MM_PAGEMAP_LEAF_BITS system pages*/
+#define MM_PAGEMAP_VA_BITS		48
+#define MM_PAGEMAP_LEAF_BITS	18
+#define MM_PAGEMAP_ROOT_SIZE	(1 << (MM_PAGEMAP_VA_BITS - 12 - MM_PAGEMAP_LEAF_BITS))
+
 vm_page_t *
-allocate_vm_page();
+allocate_vm_page(struct vm_page_family_ *vm_page_family, int units);
 
 
 #define MARK_VM_PAGE_EMPTY(vm_page_t_ptr)							\
-	vm_page_t_ptr->block_meta_data.next_block = NULL;				\
-	vm_page_t_ptr->block_meta_data.prev_block = NULL;				\
+	vm_page_t_ptr->block_meta_data.prev_offset = 0;					\
 	vm_page_t_ptr->block_meta_data.is_free = MM_TRUE;
 
 
@@ -115,11 +484,26 @@ void mm_init();
 #define ITERATE_PAGE_FAMILIES_BEGIN(vm_page_for_families_ptr, curr)	\
 {																	\
 	uint32_t count = 0; 											\
-	for(curr = (vm_page_family_t *) &vm_page_for_families_ptr -> vm_page_family[0];	\
-	curr -> struct_size && count < MAX_FAMILIES_PER_VM_PAGE;		\
+	vm_page_for_families_t *_vm_page_for_families = 				\
+							vm_page_for_families_ptr;				\
+	for(; _vm_page_for_families;									\
+		_vm_page_for_families = _vm_page_for_families->next){		\
+	for(curr = (vm_page_family_t *) &_vm_page_for_families -> vm_page_family[0], count = 0;	\
+	count < MAX_FAMILIES_PER_VM_PAGE && curr -> struct_size;		\
 	curr++, count++){
 
-#define ITERATE_PAGE_FAMILIES_END(vm_page_for_families_ptr, curr)	 }}
+#define ITERATE_PAGE_FAMILIES_END(vm_page_for_families_ptr, curr)	 }}}
+
+
+#define ITERATE_NODE_FAMILIES_BEGIN(vm_page_family_ptr, curr)		\
+{																	\
+	uint32_t _node = 0;												\
+	for(; _node < MM_NUMA_MAX_NODES; _node++){						\
+		curr = (vm_page_family_ptr)->node_families[_node];			\
+		if(!curr)													\
+			continue;
+
+#define ITERATE_NODE_FAMILIES_END(vm_page_family_ptr, curr)	}}
 
 
 #define ITERATE_VM_PAGE_BEGIN(vm_page_family_ptr, curr)     \
@@ -148,7 +532,7 @@ void mm_init();
 
 
 #define MAX_FAMILIES_PER_VM_PAGE   \
-	(SYSTEM_PAGE_SIZE - sizeof(vm_page_for_families_t *)  /\
+	((SYSTEM_PAGE_SIZE - sizeof(vm_page_for_families_t))  /\
 		sizeof(vm_page_family_t))
 
 
@@ -0,0 +1,275 @@
+/*
+ * General purpose allocation on top of the page families.
+ *
+ * Sizes up to MM_MALLOC_MAX_SIZE are rounded up to a size class, 16 byte
+ * steps up to 128 bytes then four classes per power of two, so no more
+ * than a fifth of an object is lost to rounding past 128 bytes. Every
+ * class is a slab page family named mm_malloc_<size>, registered on
+ * first use. Bigger requests get a dedicated region of the
+ * mm_malloc_large family.
+ *
+ * Slab slots are aligned to the largest power of two dividing their
+ * size up to MM_SLAB_MAX_SLOT_ALIGN, class sizes are multiples of 16,
+ * so is every object. Bigger alignments are served by the first class
+ * whose size is a multiple of the alignment, or at an aligned address
+ * inside a dedicated region, which any address in it frees.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "mm.h"
+#include "uapi_mm.h"
+
+#define MM_MALLOC_ALIGNMENT			16
+#define MM_MALLOC_SMALL_MAX			128
+#define MM_MALLOC_SMALL_CLASSES		(MM_MALLOC_SMALL_MAX / MM_MALLOC_ALIGNMENT)
+#define MM_MALLOC_MAX_SIZE_LOG2		15
+#define MM_MALLOC_MAX_SIZE			(1u << MM_MALLOC_MAX_SIZE_LOG2)
+#define MM_MALLOC_CLASSES			\
+	(MM_MALLOC_SMALL_CLASSES + (MM_MALLOC_MAX_SIZE_LOG2 - 7) * 4)
+
+/*Index of the family of dedicated regions in mm_malloc_families*/
+#define MM_MALLOC_LARGE				MM_MALLOC_CLASSES
+
+/*Block sizes are 32 bit, with room for the region header*/
+#define MM_MALLOC_MAX_LARGE_SIZE	(1ul << 31)
+
+static mm_family_t mm_malloc_families[MM_MALLOC_CLASSES + 1];
+
+#ifdef MM_THREAD_SAFE
+static pthread_mutex_t mm_malloc_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static vm_bool_t mm_malloc_initialized = MM_FALSE;
+
+static inline uint32_t
+mm_malloc_class(size_t size){
+	
+	uint32_t log2;
+	
+	if(size <= MM_MALLOC_SMALL_MAX)
+		return size ? (uint32_t)((size - 1) / MM_MALLOC_ALIGNMENT) : 0;
+	
+	/*size is in (2^log2, 2^(log2 + 1)], split in 4 steps of 2^(log2 - 2)*/
+	log2 = 63 - __builtin_clzl(size - 1);
+	return MM_MALLOC_SMALL_CLASSES + (log2 - 7) * 4 +
+			(uint32_t)((size - 1) >> (log2 - 2)) + 1 - 5;
+}
+
+static inline uint32_t
+mm_malloc_class_size(uint32_t class){
+	
+	uint32_t step;
+	
+	if(class < MM_MALLOC_SMALL_CLASSES)
+		return (class + 1) * MM_MALLOC_ALIGNMENT;
+	
+	class -= MM_MALLOC_SMALL_CLASSES;
+	step = 1u << (7 + class / 4 - 2);
+	return (5 + class % 4) * step;
+}
+
+/*Family of a size class, or of the dedicated regions, registered by the
+  first thread asking for it*/
+static mm_family_t
+mm_malloc_family(uint32_t class){
+	
+	mm_family_t family = __atomic_load_n(&mm_malloc_families[class],
+							__ATOMIC_ACQUIRE);
+	char struct_name[MM_MAX_STRUCT_NAME];
+	
+	if(family)
+		return family;
+	
+	MM_LOCK(&mm_malloc_lock);
+	
+	family = mm_malloc_families[class];
+	if(family)
+		goto done;
+	
+	if(!mm_malloc_initialized){
+		mm_init();
+		mm_malloc_initialized = MM_TRUE;
+	}
+	
+	if(class == MM_MALLOC_LARGE){
+		family = mm_instantiate_new_page_family("mm_malloc_large", 1);
+		if(family)
+			mm_family_set_large_threshold(family, 0);
+	}
+	else{
+		snprintf(struct_name, sizeof(struct_name), "mm_malloc_%u",
+			mm_malloc_class_size(class));
+		family = mm_instantiate_new_page_family_with_flags(struct_name,
+					mm_malloc_class_size(class), MM_FAMILY_SLAB);
+	}
+	
+	__atomic_store_n(&mm_malloc_families[class], family, __ATOMIC_RELEASE);
+	
+done:
+	MM_UNLOCK(&mm_malloc_lock);
+	return family;
+}
+
+static void *
+mm_malloc_from_class(uint32_t class, size_t size, vm_bool_t zero){
+	
+	mm_family_t family = mm_malloc_family(class);
+	void *ptr = NULL;
+	
+	/*Zeroing stops at size, a class object is its family structure*/
+	if(family){
+		ptr = zero ? xcalloc_family_bytes(family, size ? size : 1) :
+					 xmalloc_family_bytes(family, size ? size : 1);
+	}
+	
+	if(!ptr)
+		errno = ENOMEM;
+	return ptr;
+}
+
+static void *
+mm_malloc_large(size_t size, vm_bool_t zero){
+	
+	mm_family_t family;
+	void *ptr = NULL;
+	
+	if(size > MM_MALLOC_MAX_LARGE_SIZE){
+		errno = ENOMEM;
+		return NULL;
+	}
+	
+	family = mm_malloc_family(MM_MALLOC_LARGE);
+	if(family){
+		ptr = zero ? xcalloc_family_bytes(family, size) :
+					 xmalloc_family_bytes(family, size);
+	}
+	
+	if(!ptr)
+		errno = ENOMEM;
+	return ptr;
+}
+
+void *
+mm_malloc(size_t size){
+	
+	if(size > MM_MALLOC_MAX_SIZE)
+		return mm_malloc_large(size, MM_FALSE);
+	return mm_malloc_from_class(mm_malloc_class(size), size, MM_FALSE);
+}
+
+void *
+mm_calloc(size_t n, size_t size){
+	
+	size_t total;
+	
+	if(__builtin_mul_overflow(n, size, &total)){
+		errno = ENOMEM;
+		return NULL;
+	}
+	
+	if(total > MM_MALLOC_MAX_SIZE)
+		return mm_malloc_large(total, MM_TRUE);
+	return mm_malloc_from_class(mm_malloc_class(total), total, MM_TRUE);
+}
+
+void
+mm_free(void *ptr){
+	
+	if(ptr)
+		xfree(ptr);
+}
+
+void *
+mm_realloc(void *ptr, size_t size){
+	
+	size_t usable;
+	void *new_ptr;
+	
+	if(!ptr)
+		return mm_malloc(size);
+	
+	if(!size){
+		mm_free(ptr);
+		return NULL;
+	}
+	
+	usable = mm_usable_size(ptr);
+	if(!usable){
+		printf("Error : %s() %p was not allocated by Memory Manager\n",
+			__FUNCTION__, ptr);
+		errno = EINVAL;
+		return NULL;
+	}
+	
+	/*Dedicated regions are resized in place or through mremap(), the
+	  large family counts in bytes*/
+	if(usable > MM_MALLOC_MAX_SIZE && size > MM_MALLOC_MAX_SIZE &&
+			size < MM_MALLOC_MAX_LARGE_SIZE){
+		new_ptr = xrealloc(ptr, (int)size);
+		if(!new_ptr)
+			errno = ENOMEM;
+		return new_ptr;
+	}
+	
+	/*Keep the object unless it would waste more than half of it*/
+	if(size <= usable && size > usable / 2)
+		return ptr;
+	
+	new_ptr = mm_malloc(size);
+	if(!new_ptr)
+		return NULL;
+	
+	memcpy(new_ptr, ptr, size < usable ? size : usable);
+	mm_free(ptr);
+	return new_ptr;
+}
+
+void *
+mm_aligned_alloc(size_t alignment, size_t size){
+	
+	uint32_t class;
+	char *region;
+	
+	if(!alignment || (alignment & (alignment - 1))){
+		errno = EINVAL;
+		return NULL;
+	}
+	
+	if(alignment <= MM_MALLOC_ALIGNMENT)
+		return mm_malloc(size);
+	
+	if(alignment <= MM_SLAB_MAX_SLOT_ALIGN && size <= MM_MALLOC_MAX_SIZE){
+		for(class = mm_malloc_class(size); class < MM_MALLOC_CLASSES; class++){
+			if(!(mm_malloc_class_size(class) % alignment))
+				return mm_malloc_from_class(class, size, MM_FALSE);
+		}
+	}
+	
+	if(size > MM_MALLOC_MAX_LARGE_SIZE - alignment){
+		errno = ENOMEM;
+		return NULL;
+	}
+	
+	region = mm_malloc_large(size + alignment, MM_FALSE);
+	if(!region)
+		return NULL;
+	
+	return (void *)(((uintptr_t)region + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+int
+mm_posix_memalign(void **out, size_t alignment, size_t size){
+	
+	void *ptr;
+	
+	if(alignment < sizeof(void *) || (alignment & (alignment - 1)))
+		return EINVAL;
+	
+	ptr = mm_aligned_alloc(alignment, size);
+	if(!ptr)
+		return ENOMEM;
+	
+	*out = ptr;
+	return 0;
+}
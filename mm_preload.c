@@ -0,0 +1,93 @@
+/*
+ * LD_PRELOAD shim : runs an unmodified program on the memory manager by
+ * interposing the C library allocation functions with the mm_malloc()
+ * ones, to compare the two on real workloads.
+ *
+ * Build : gcc -O2 -shared -fPIC -fvisibility=hidden -DMM_THREAD_SAFE \
+ *             -ftls-model=initial-exec -I. -Iglthread mm_preload.c \
+ *             mm_malloc.c mm.c glthread/glthread.c -pthread \
+ *             -o libmm_preload.so
+ *
+ * Run   : LD_PRELOAD=./libmm_preload.so ./service
+ *
+ * Only the functions below are exported, programs bringing their own
+ * xmalloc() or xfree(), as bash and binutils do, must neither reach the
+ * memory manager ones nor have them call back into theirs.
+ *
+ * Pointers the memory manager did not hand out, from the dynamic loader
+ * before the shim was in place, are ignored by free(). No fork handler
+ * takes the family locks, a child forked while another thread holds one
+ * must exec before allocating.
+ */
+#include <errno.h>
+#include <unistd.h>
+#include "uapi_mm.h"
+
+#define MM_PRELOAD_EXPORT	__attribute__((visibility("default")))
+
+MM_PRELOAD_EXPORT void *
+malloc(size_t size){
+	
+	return mm_malloc(size);
+}
+
+MM_PRELOAD_EXPORT void *
+calloc(size_t n, size_t size){
+	
+	return mm_calloc(n, size);
+}
+
+MM_PRELOAD_EXPORT void *
+realloc(void *ptr, size_t size){
+	
+	if(ptr && !mm_usable_size(ptr)){
+		errno = ENOMEM;
+		return NULL;
+	}
+	return mm_realloc(ptr, size);
+}
+
+MM_PRELOAD_EXPORT void
+free(void *ptr){
+	
+	if(mm_usable_size(ptr))
+		mm_free(ptr);
+}
+
+MM_PRELOAD_EXPORT int
+posix_memalign(void **out, size_t alignment, size_t size){
+	
+	return mm_posix_memalign(out, alignment, size);
+}
+
+MM_PRELOAD_EXPORT void *
+aligned_alloc(size_t alignment, size_t size){
+	
+	return mm_aligned_alloc(alignment, size);
+}
+
+MM_PRELOAD_EXPORT void *
+memalign(size_t alignment, size_t size){
+	
+	return mm_aligned_alloc(alignment, size);
+}
+
+MM_PRELOAD_EXPORT void *
+valloc(size_t size){
+	
+	return mm_aligned_alloc(getpagesize(), size);
+}
+
+MM_PRELOAD_EXPORT void *
+pvalloc(size_t size){
+	
+	size_t page_size = getpagesize();
+	
+	return mm_aligned_alloc(page_size, (size + page_size - 1) & ~(page_size - 1));
+}
+
+MM_PRELOAD_EXPORT size_t
+malloc_usable_size(void *ptr){
+	
+	return mm_usable_size(ptr);
+}
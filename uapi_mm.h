@@ -2,36 +2,440 @@
 #define __UAPI_MM__
 
 #include <stdint.h>
+#include <stddef.h>
+
+/*Forward Declaration*/
+struct vm_page_family_;
+
+/*Handle to a registered page family. A handle stays valid for the
+  life of the process, so applications may cache it and allocate
+  through it without a lookup by structure name*/
+typedef struct vm_page_family_ * mm_family_t;
 
 void *
 xcalloc(char *struct_name, int units);
 
+/*Allocate 'units' objects from an already resolved page family*/
+void *
+xcalloc_family(mm_family_t family, int units);
+
+/*Allocate 'req_size' bytes from an already resolved page family,
+  used by the per type fast paths where the size is a constant*/
+void *
+xcalloc_family_bytes(mm_family_t family, uint32_t req_size);
+
+/*Like the xcalloc functions without zeroing the memory, for callers
+  which initialize every field themselves*/
+void *
+xmalloc(char *struct_name, int units);
+
+void *
+xmalloc_family(mm_family_t family, int units);
+
+void *
+xmalloc_family_bytes(mm_family_t family, uint32_t req_size);
+
 void 
 xfree(void *app_data);
 
-/*Wrapper over xcalloc to resemble calloc*/
-#define XCALLOC(units, struct_name) \
-	(xcalloc(#struct_name, units))
+/*Resize app_data to new_units objects of its page family, like realloc
+  the bytes added are not initialized and app_data stays valid when NULL
+  is returned. Blocks grow into the free block after them and shrink in
+  place, dedicated regions grow over the free pages after them or through
+  mremap(). The object is moved only as a last resort. new_units of 0
+  frees app_data*/
+void *
+xrealloc(void *app_data, int new_units);
+
+/*Like xcalloc_family() with the data aligned to align, a power of 2.
+  Alignments up to the one of the family cost nothing, stricter ones may
+  leave a free block in front of the data. mm_compact() only keeps the
+  alignment of the family, objects of a family with a relocation
+  callback may lose a stricter one when moved*/
+void *
+xcalloc_aligned(mm_family_t family, int units, uint32_t align);
+
+/*Allocate n zeroed objects of the page family into out, carved back to
+  back from as few free blocks as possible under one lock acquisition.
+  Returns the number of objects allocated, less than n only when the
+  memory manager runs out of memory*/
+int
+xcalloc_bulk(mm_family_t family, int n, void **out);
+
+/*Free n objects at once. Neighbouring objects are merged into one free
+  block before it is linked back, objects of one family are freed under
+  one lock acquisition*/
+void
+xfree_bulk(void **ptrs, int n);
+
+/*General purpose allocation, for code which does not register its
+  structures. Sizes are rounded up to size classes, each one a slab page
+  family registered on first use, see mm_malloc.c. Bigger requests get
+  a dedicated region. Memory is 16 byte aligned, the functions follow
+  their C library namesakes, errno included*/
+void *
+mm_malloc(size_t size);
+
+void *
+mm_calloc(size_t n, size_t size);
+
+void *
+mm_realloc(void *ptr, size_t size);
+
+void
+mm_free(void *ptr);
+
+int
+mm_posix_memalign(void **out, size_t alignment, size_t size);
+
+void *
+mm_aligned_alloc(size_t alignment, size_t size);
+
+/*Bytes usable at app_data, 0 when the memory manager did not allocate it*/
+size_t
+mm_usable_size(void *app_data);
+
+/*Per call site cache of a page family handle. The atomics only keep
+  threads racing on the first lookup well defined*/
+#define MM_CACHED_FAMILY_LOOKUP(cache, struct_name)						\
+	({																	\
+		mm_family_t _family = __atomic_load_n(&(cache), __ATOMIC_ACQUIRE);\
+		if(!_family){													\
+			_family = lookup_page_family_by_name(#struct_name);			\
+			__atomic_store_n(&(cache), _family, __ATOMIC_RELEASE);		\
+		}																\
+		_family;														\
+	})
+
+/*Wrapper over xcalloc to resemble calloc. The page family is resolved
+  once per call site and cached, later calls skip the name lookup*/
+#define XCALLOC(units, struct_name)									\
+	({																\
+		static mm_family_t _mm_family = NULL;						\
+		mm_family_t _mm_family_resolved =							\
+			MM_CACHED_FAMILY_LOOKUP(_mm_family, struct_name);		\
+		_mm_family_resolved ?										\
+			xcalloc_family(_mm_family_resolved, units) :			\
+			xcalloc(#struct_name, units);							\
+	})
+	
+#define XMALLOC(units, struct_name)									\
+	({																\
+		static mm_family_t _mm_family = NULL;						\
+		mm_family_t _mm_family_resolved =							\
+			MM_CACHED_FAMILY_LOOKUP(_mm_family, struct_name);		\
+		_mm_family_resolved ?										\
+			xmalloc_family(_mm_family_resolved, units) :			\
+			xmalloc(#struct_name, units);							\
+	})
 	
 #define XFREE(ptr)	\
 	(xfree(ptr))
 
+#define XREALLOC(ptr, units)	\
+	(xrealloc(ptr, units))
+
 /*Initialization Functions*/
 void mm_init();
 
-/*Registration function*/
-void mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size);
+/*Return the objects cached by the calling thread to their page families.
+  Threads flush automatically on exit, a no-op unless built with
+  MM_THREAD_SAFE*/
+void mm_thread_cache_flush();
+
+/*Arenas : many short lived objects, of one request say, bump allocated
+  from pages of the arena and freed all at once. Objects carry no meta
+  data and are never passed to xfree(). An arena is used by one thread
+  at a time, its pages show in mm_print_memory_usage() under its name*/
+typedef struct vm_arena_ * mm_arena_t;
+
+/*NULL when out of memory*/
+mm_arena_t mm_arena_create(char *name);
+
+/*size bytes aligned to 16, not initialized. NULL when out of memory*/
+void *mm_arena_alloc(mm_arena_t arena, size_t size);
+
+/*Free every object of the arena, in time linear in its pages. Pages
+  are kept for the next round but those of the biggest requests*/
+void mm_arena_reset(mm_arena_t arena);
+
+/*Free every object and give all pages back to the kernel*/
+void mm_arena_destroy(mm_arena_t arena);
+
+/*Page family registration flags*/
+/*Single object allocations are packed into slab pages tracked by an
+  occupancy bitmap, with no per object meta data. Multi unit requests
+  still use data blocks*/
+#define MM_FAMILY_SLAB		(1u << 0)
+
+/*Every object of the family starts on a cache line, for objects written
+  by different threads. Slab slots are rounded up to whole cache lines*/
+#define MM_FAMILY_CACHE_ALIGNED	(1u << 1)
+
+/*As aligned, and every object is padded to whole cache lines so that no
+  two objects, nor the meta data of another one, share a cache line*/
+#define MM_FAMILY_CACHE_PADDED	(1u << 2)
+
+#define MM_CACHE_LINE_SIZE		64
+
+/*Keep the pages and free lists of the family per NUMA node, each bound
+  to its node with mbind(). Allocations are served from the node the
+  calling thread runs on, objects go back to the node they came from
+  whoever frees them. Same as no flag on single node machines*/
+#define MM_FAMILY_NUMA_LOCAL	(1u << 3)
+
+/*Placement policy, which free block a data block is carved from, one
+  of the four below. Slab slots and dedicated regions are not affected.
+  Worst fit, the default, takes a block of the biggest size class and
+  leaves big remainders, it spreads objects over all pages. Best fit
+  takes the smallest block that fits. First fit takes the lowest address
+  block that fits, it keeps the free lists in address order and every
+  free block linked walks its list, the slowest of the four once a heap
+  holds many free blocks. Densest page takes a block of the fullest
+  page, so that lightly used pages empty out and go back to the page
+  caches. Best fit and densest page look at a few blocks from the size
+  class of the request upwards, not at all free blocks*/
+#define MM_FAMILY_WORST_FIT		(0u << 4)
+#define MM_FAMILY_BEST_FIT		(1u << 4)
+#define MM_FAMILY_FIRST_FIT		(2u << 4)
+#define MM_FAMILY_DENSEST_PAGE	(3u << 4)
+#define MM_FAMILY_PLACEMENT_MASK	(3u << 4)
+
+/*Page families grow in spans of whole system pages, one page unless
+  configured otherwise. Spans of big structures are grown to hold a few
+  of them. Span sizes apply to spans allocated afterwards, call after
+  mm_init()*/
+void mm_set_default_span_size(uint32_t span_size);
+void mm_family_set_span_size(mm_family_t family, uint32_t span_size);
+
+/*Requests above large_threshold bytes, or too big for a span, get a
+  dedicated mmap'd region still tracked by the family*/
+void mm_family_set_large_threshold(mm_family_t family, uint32_t large_threshold);
+
+/*Back the chunks a family grows into with 2 MB pages, to cut TLB misses
+  over big heaps. MM_HUGE_PAGES_HUGETLB maps chunks from the hugetlbfs
+  pool (see /proc/sys/vm/nr_hugepages) and falls back to transparent
+  huge pages when it cannot reserve them. Applies to chunks mapped
+  afterwards*/
+typedef enum{
+	MM_HUGE_PAGES_OFF,		/*default*/
+	MM_HUGE_PAGES_THP,		/*madvise(MADV_HUGEPAGE)*/
+	MM_HUGE_PAGES_HUGETLB	/*MAP_HUGETLB*/
+} mm_huge_pages_t;
+
+void mm_family_set_huge_pages(mm_family_t family, mm_huge_pages_t huge_pages);
+
+/*Compaction : mm_compact() moves the live objects of the sparsest VM
+  data pages of a family into the free space of the other pages, then
+  gives the emptied pages back to the kernel. Only families with a
+  relocation callback are compacted, it is called for every object moved
+  once its size bytes were copied to new_address, with the family
+  locked, for the application to repoint its references. It must not
+  allocate from or free to the family, and no other thread may use the
+  objects of the family until mm_compact() returns. Moved objects keep
+  the alignment of the family, not a stricter one requested through
+  xcalloc_aligned(). Set the callback before allocating from the family,
+  objects of such families skip the per thread caches*/
+typedef void (*mm_relocate_fn_t)(void *old_address, void *new_address,
+						uint32_t size, void *arg);
+
+void mm_family_set_relocation_callback(mm_family_t family,
+						mm_relocate_fn_t relocate, void *arg);
+
+/*Returns the number of system pages released*/
+uint32_t mm_compact(mm_family_t family);
+
+/*Empty spans are retained for reuse instead of being returned to the
+  kernel right away. A family keeps up to high of them, then moves all
+  but low to the global cache, which past its own high watermark
+  releases all but low of its pages in one batch*/
+void mm_set_page_cache_watermarks(uint32_t low, uint32_t high);
+void mm_family_set_page_cache_watermarks(mm_family_t family,
+						uint32_t low, uint32_t high);
+
+/*Released pages keep their address space in the chunk they were carved
+  from, chunks are unmapped once empty*/
+typedef enum{
+	MM_PAGE_RELEASE_MADV_DONTNEED,	/*drop the memory at once (default)*/
+	MM_PAGE_RELEASE_MADV_FREE		/*let the kernel reclaim it lazily*/
+} mm_page_release_mode_t;
+
+void mm_set_page_release_mode(mm_page_release_mode_t mode);
+
+/*Release every retained empty page and unmap the chunks left empty*/
+void mm_trim_page_caches();
+
+/*Counters of a page family, maintained on the allocation paths, so
+  cheap enough to read in production. Objects count once whatever the
+  number of units they were allocated with*/
+typedef struct mm_stats_{
+	uint64_t allocations;		/*objects allocated so far*/
+	uint64_t frees;				/*objects freed so far*/
+	uint64_t live_objects;		/*allocations - frees*/
+	uint64_t bytes_allocated;	/*bytes handed out to the live objects*/
+	uint64_t bytes_reserved;	/*bytes of the pages the family holds*/
+	uint64_t free_blocks;		/*free data blocks and free slab slots*/
+	uint32_t vm_pages;			/*system pages in use*/
+	uint32_t vm_pages_cached;	/*empty system pages kept for reuse*/
+	uint64_t mmap_calls;		/*mappings made for the family*/
+	uint64_t munmap_calls;		/*mappings returned*/
+	/*Node locality of MM_FAMILY_NUMA_LOCAL families, objects served from
+	  or freed to the pages of another node than the one of the calling
+	  thread are remote. Everything is local on single node machines*/
+	uint64_t numa_local_allocations;
+	uint64_t numa_remote_allocations;
+	uint64_t numa_remote_frees;
+} mm_stats_t;
+
+/*O(1) in the heap size, it sums the counters of the threads which
+  allocated from the family in MM_THREAD_SAFE builds, and of the nodes
+  of NUMA families*/
+void mm_get_stats(mm_family_t family, mm_stats_t *stats);
+
+/*Latency histograms, built with -DMM_LATENCY_STATS only. Operations are
+  timed with the TSC (clock_gettime() nanoseconds off x86) and counted
+  into log linear buckets per page family : values below
+  MM_LATENCY_SUB_BUCKETS ticks get a bucket each, every power of two
+  above is split in MM_LATENCY_SUB_BUCKETS linear buckets, so a bucket
+  is within 1/MM_LATENCY_SUB_BUCKETS of the values it counts. The last
+  bucket also counts everything longer*/
+typedef enum{
+	MM_LATENCY_ALLOC,			/*xcalloc and xmalloc, any variant*/
+	MM_LATENCY_FREE,			/*xfree*/
+	MM_LATENCY_PAGE_ACQUIRE,	/*new VM data page, from a cache or the kernel*/
+	MM_LATENCY_PAGE_RELEASE,	/*VM data page memory given back*/
+	MM_LATENCY_OPS
+} mm_latency_op_t;
+
+#define MM_LATENCY_SUB_BUCKET_BITS	3
+#define MM_LATENCY_SUB_BUCKETS		(1 << MM_LATENCY_SUB_BUCKET_BITS)
+#define MM_LATENCY_MAX_LOG2			39
+#define MM_LATENCY_BUCKETS			\
+	((MM_LATENCY_MAX_LOG2 - MM_LATENCY_SUB_BUCKET_BITS + 2) * MM_LATENCY_SUB_BUCKETS)
+
+typedef struct mm_latency_histogram_{
+	uint64_t count;
+	uint64_t total_ticks;
+	uint64_t max_ticks;
+	uint64_t buckets[MM_LATENCY_BUCKETS];
+} mm_latency_histogram_t;
+
+/*Time one in every period allocations and frees of each thread, 1 by
+  default. VM page acquires and releases are rare and always timed.
+  0 stops timing altogether*/
+void mm_set_latency_sampling(uint32_t period);
+
+/*Copy of the histogram of op for the family, all zeros in builds
+  without MM_LATENCY_STATS*/
+void mm_get_latency_histogram(mm_family_t family, mm_latency_op_t op,
+						mm_latency_histogram_t *histogram);
+
+void mm_reset_latency_histograms(mm_family_t family);
+
+/*Smallest and largest number of ticks counted in a bucket*/
+uint64_t mm_latency_bucket_low(uint32_t bucket);
+uint64_t mm_latency_bucket_high(uint32_t bucket);
+
+/*Upper bound of the bucket holding the given percentile (0 to 100),
+  in ticks*/
+uint64_t mm_latency_percentile(const mm_latency_histogram_t *histogram,
+						double percentile);
+
+/*Calibrated on the first call, takes a few milliseconds*/
+double mm_latency_ns_per_tick();
+
+/*Count, mean, p50, p99, p99.9 and max of every timed operation of every
+  family, in nanoseconds, followed by the non empty buckets when verbose*/
+void mm_print_latency_histograms(int verbose);
+
+/*Heap profiler, built with -DMM_HEAP_PROFILE only. Allocations are
+  sampled on average once every rate bytes, the call stack of a sampled
+  object is kept until it is freed. A sample stands for rate bytes, the
+  live bytes of a call site are estimated without bias whatever the size
+  of its objects. 0 stops sampling*/
+#define MM_HEAP_PROFILE_DEFAULT_RATE	(512 * 1024)
+
+void mm_set_heap_profile_rate(uint64_t rate);
+
+/*Write the estimated live bytes of every call site of every family to
+  path, stdout when NULL, as collapsed stacks, one line per distinct
+  stack :
+	struct_name;outermost_frame;...;allocating_frame bytes
+  as flamegraph.pl and most flame graph viewers read them. Frames are
+  resolved with dladdr(), link with -rdynamic to name the functions of
+  the executable and with -ldl before glibc 2.34. Returns 0, -1 when the
+  file cannot be written or without MM_HEAP_PROFILE*/
+int mm_dump_heap_profile(const char *path);
+
+/*Registration function, returns the handle of the new page family*/
+mm_family_t mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size);
+
+mm_family_t mm_instantiate_new_page_family_with_flags(char *struct_name,
+						uint32_t struct_size, uint32_t flags);
+
+/*Function to return the page family handle registered for struct_name*/
+mm_family_t lookup_page_family_by_name (char *struct_name);
 
 /*Function of print all registered page families*/
 void mm_print_registered_page_families ();
 
 
 void mm_print_memory_usage(char *struct_name);
+
+/*The page counts reported by mm_print_memory_usage(), for programs
+  which track them. A NULL struct_name covers every family and arena,
+  cached pages then include the global cache. Arena pages are in use*/
+typedef struct mm_memory_usage_{
+	uint32_t vm_pages_in_use;
+	uint32_t vm_pages_cached;
+	uint32_t n_chunks;
+	uint64_t chunk_bytes_reserved;
+} mm_memory_usage_t;
+
+void mm_get_memory_usage(char *struct_name, mm_memory_usage_t *usage);
+
+/*Block counts of a page family, from the walk mm_print_block_usage()
+  does. Slab slots count as blocks*/
+typedef struct mm_block_usage_{
+	uint32_t vm_pages;
+	uint32_t total_block_count;
+	uint32_t free_block_count;
+	uint32_t occupied_block_count;
+	uint64_t application_memory_usage;
+	uint64_t meta_data_usage;
+	uint64_t free_memory;
+	uint32_t largest_free_block;
+} mm_block_usage_t;
+
+void mm_get_block_usage(mm_family_t family, mm_block_usage_t *usage);
+
 void mm_print_block_usage();
 
 
 #define MM_REG_STRUCT(struct_name)  \
 	(mm_instantiate_new_page_family(#struct_name, sizeof(struct_name)))
+
+#define MM_REG_STRUCT_FLAGS(struct_name, flags)  \
+	(mm_instantiate_new_page_family_with_flags(#struct_name, sizeof(struct_name), flags))
+
+/*Generates per type fast paths <struct_name>_alloc(), _alloc_n() and
+  _free(). The family handle is resolved once per translation unit and
+  the request size is a compile time constant*/
+#define MM_DECLARE_STRUCT_ALLOCATOR(struct_name)						\
+	static inline mm_family_t struct_name##_mm_family(void){			\
+		static mm_family_t family = NULL;								\
+		return MM_CACHED_FAMILY_LOOKUP(family, struct_name);			\
+	}																	\
+	static inline struct_name * struct_name##_alloc(void){				\
+		return (struct_name *)xcalloc_family_bytes(						\
+				struct_name##_mm_family(), sizeof(struct_name));		\
+	}																	\
+	static inline struct_name * struct_name##_alloc_n(int units){		\
+		return (struct_name *)xcalloc_family_bytes(						\
+				struct_name##_mm_family(), units * sizeof(struct_name));\
+	}																	\
+	static inline void struct_name##_free(struct_name *ptr){			\
+		xfree(ptr);														\
+	}
 	
 #endif /*__UAPI_MM__*/
-